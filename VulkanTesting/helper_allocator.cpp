@@ -0,0 +1,269 @@
+//
+//  helper_allocator.cpp
+//  VulkanTesting
+//
+//  VkAllocationCallbacks that count the driver's host allocations, and can serve the short-lived ones from pools.
+//
+#include "helper_allocator.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// Sits right in front of every block we hand out, so free knows where the block came from and how big it was.
+// 32 bytes keeps the block after it 16-byte aligned, which is as much as malloc guarantees anyway
+struct alignas(16) BlockHeader {
+    void* base;      // what to give back to free(), or the pool block
+    size_t size;     // what the driver asked for
+    void* category;  // the Category it was counted in
+    uint8_t scope;
+    uint8_t pool;    // index in pools, or noPool
+};
+static_assert(sizeof(BlockHeader) == 32, "BlockHeader should stay 32 bytes");
+
+static const uint8_t noPool = 0xff;
+static const size_t poolChunkBlocks = 32; // blocks a pool gets from malloc at a time
+static const size_t smallestPoolBlock = 64;
+
+static BlockHeader* headerOf(void* memory) {
+    return reinterpret_cast<BlockHeader*>(static_cast<char*>(memory) - sizeof(BlockHeader));
+}
+
+static const char* scopeName(size_t scope) {
+    switch (scope) {
+        case VK_SYSTEM_ALLOCATION_SCOPE_COMMAND: return "command";
+        case VK_SYSTEM_ALLOCATION_SCOPE_OBJECT: return "object";
+        case VK_SYSTEM_ALLOCATION_SCOPE_CACHE: return "cache";
+        case VK_SYSTEM_ALLOCATION_SCOPE_DEVICE: return "device";
+        case VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE: return "instance";
+        default: return "unknown";
+    }
+}
+
+const char* hostAllocationObjectName(HostAllocationObject object) {
+    switch (object) {
+        case HostAllocationObject::Instance: return "instance";
+        case HostAllocationObject::Surface: return "surface";
+        case HostAllocationObject::DebugMessenger: return "debug messenger";
+        case HostAllocationObject::Device: return "device";
+        case HostAllocationObject::Swapchain: return "swapchain";
+        case HostAllocationObject::Image: return "image";
+        case HostAllocationObject::ImageView: return "image view";
+        case HostAllocationObject::Memory: return "memory";
+        case HostAllocationObject::Framebuffer: return "framebuffer";
+        case HostAllocationObject::RenderPass: return "render pass";
+        case HostAllocationObject::ShaderModule: return "shader module";
+        case HostAllocationObject::Pipeline: return "pipeline";
+        case HostAllocationObject::CommandPool: return "command pool";
+        case HostAllocationObject::Semaphore: return "semaphore";
+        case HostAllocationObject::Fence: return "fence";
+        case HostAllocationObject::QueryPool: return "query pool";
+        case HostAllocationObject::Buffer: return "buffer";
+        case HostAllocationObject::Count: break;
+    }
+    return "unknown";
+}
+
+HostAllocationTracker::~HostAllocationTracker() {
+    for (Pool& pool : pools) {
+        for (void* chunk : pool.chunks) {
+            std::free(chunk);
+        }
+    }
+}
+
+void HostAllocationTracker::enable(bool pooling) {
+    for (size_t i = 0; i < categories.size(); i++) {
+        Category& category = categories[i];
+        category.tracker = this;
+        category.object = static_cast<HostAllocationObject>(i);
+        category.callbacks.pUserData = &category;
+        category.callbacks.pfnAllocation = allocationCallback;
+        category.callbacks.pfnReallocation = reallocationCallback;
+        category.callbacks.pfnFree = freeCallback;
+        category.callbacks.pfnInternalAllocation = internalAllocationCallback;
+        category.callbacks.pfnInternalFree = internalFreeCallback;
+    }
+    for (size_t i = 0; i < pools.size(); i++) {
+        pools[i].blockSize = smallestPoolBlock << i;
+    }
+    trackingEnabled = true;
+    poolingEnabled = pooling;
+}
+
+const VkAllocationCallbacks* HostAllocationTracker::callbacks(HostAllocationObject object) const {
+    if (!trackingEnabled) return nullptr;
+    return &categories[static_cast<size_t>(object)].callbacks;
+}
+
+void HostAllocationTracker::count(Category& category, VkSystemAllocationScope scope, size_t size) {
+    Counters& counters = category.scopes[scope];
+    counters.liveCount.fetch_add(1, std::memory_order_relaxed);
+    counters.totalCount.fetch_add(1, std::memory_order_relaxed);
+    uint64_t live = counters.liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+    uint64_t peak = counters.peakBytes.load(std::memory_order_relaxed);
+    while (live > peak && !counters.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+        // peak was reloaded by the failed exchange, try again unless someone else already raised it past us
+    }
+}
+
+void HostAllocationTracker::uncount(Category& category, VkSystemAllocationScope scope, size_t size) {
+    Counters& counters = category.scopes[scope];
+    counters.liveCount.fetch_sub(1, std::memory_order_relaxed);
+    counters.liveBytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+void* HostAllocationTracker::allocateFromPool(size_t size, size_t alignment, VkSystemAllocationScope scope, uint8_t& poolIndex) {
+    // Only the short-lived scopes: that's where the churn is. Device and instance scope allocations live as long as their object anyway
+    if (!poolingEnabled || alignment > alignof(BlockHeader)) return nullptr;
+    if (scope != VK_SYSTEM_ALLOCATION_SCOPE_COMMAND && scope != VK_SYSTEM_ALLOCATION_SCOPE_OBJECT) return nullptr;
+
+    for (size_t i = 0; i < pools.size(); i++) {
+        Pool& pool = pools[i];
+        if (size > pool.blockSize) continue;
+
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        if (pool.freeBlocks.empty()) {
+            size_t stride = sizeof(BlockHeader) + pool.blockSize;
+            char* chunk = static_cast<char*>(std::malloc(stride * poolChunkBlocks));
+            if (chunk == nullptr) return nullptr;
+            pool.chunks.push_back(chunk);
+            for (size_t block = 0; block < poolChunkBlocks; block++) {
+                pool.freeBlocks.push_back(chunk + block * stride);
+            }
+        }
+        void* block = pool.freeBlocks.back();
+        pool.freeBlocks.pop_back();
+        pool.hits.fetch_add(1, std::memory_order_relaxed);
+        poolIndex = static_cast<uint8_t>(i);
+        return block;
+    }
+    return nullptr;
+}
+
+void* HostAllocationTracker::allocate(Category& category, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+    if (size == 0) return nullptr;
+    if (alignment < alignof(BlockHeader)) {
+        alignment = alignof(BlockHeader);
+    }
+
+    uint8_t poolIndex = noPool;
+    void* base = allocateFromPool(size, alignment, scope, poolIndex);
+    char* memory;
+    if (base != nullptr) {
+        memory = static_cast<char*>(base) + sizeof(BlockHeader);
+    } else {
+        // Room for the header plus whatever it takes to align the block after it
+        base = std::malloc(size + sizeof(BlockHeader) + alignment);
+        if (base == nullptr) return nullptr; // the driver turns this into VK_ERROR_OUT_OF_HOST_MEMORY
+        uintptr_t address = reinterpret_cast<uintptr_t>(base) + sizeof(BlockHeader);
+        address = (address + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+        memory = reinterpret_cast<char*>(address);
+    }
+
+    BlockHeader* header = headerOf(memory);
+    header->base = base;
+    header->size = size;
+    header->category = &category;
+    header->scope = static_cast<uint8_t>(scope);
+    header->pool = poolIndex;
+    count(category, scope, size);
+    return memory;
+}
+
+void HostAllocationTracker::release(void* memory) {
+    if (memory == nullptr) return;
+    BlockHeader* header = headerOf(memory);
+    uncount(*static_cast<Category*>(header->category), static_cast<VkSystemAllocationScope>(header->scope), header->size);
+    if (header->pool == noPool) {
+        std::free(header->base);
+    } else {
+        Pool& pool = pools[header->pool];
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.freeBlocks.push_back(header->base);
+    }
+}
+
+void* HostAllocationTracker::reallocate(Category& category, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+    if (original == nullptr) {
+        return allocate(category, size, alignment, scope);
+    }
+    if (size == 0) {
+        release(original);
+        return nullptr;
+    }
+    // Always a new block: the old one may be in the wrong pool or scope. If this fails the original must stay untouched, which it does
+    void* memory = allocate(category, size, alignment, scope);
+    if (memory != nullptr) {
+        size_t oldSize = headerOf(original)->size;
+        memcpy(memory, original, oldSize < size ? oldSize : size);
+        release(original);
+    }
+    return memory;
+}
+
+void* VKAPI_CALL HostAllocationTracker::allocationCallback(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+    Category* category = static_cast<Category*>(userData);
+    return category->tracker->allocate(*category, size, alignment, scope);
+}
+
+void* VKAPI_CALL HostAllocationTracker::reallocationCallback(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+    Category* category = static_cast<Category*>(userData);
+    return category->tracker->reallocate(*category, original, size, alignment, scope);
+}
+
+void VKAPI_CALL HostAllocationTracker::freeCallback(void* userData, void* memory) {
+    static_cast<Category*>(userData)->tracker->release(memory);
+}
+
+void VKAPI_CALL HostAllocationTracker::internalAllocationCallback(void* userData, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope) {
+    static_cast<Category*>(userData)->scopes[scope].internalBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+void VKAPI_CALL HostAllocationTracker::internalFreeCallback(void* userData, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope) {
+    static_cast<Category*>(userData)->scopes[scope].internalBytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+void HostAllocationTracker::beginFrames() {
+    for (Category& category : categories) {
+        for (Counters& counters : category.scopes) {
+            counters.totalAtFrameStart = counters.totalCount.load(std::memory_order_relaxed);
+        }
+    }
+    framesStarted = true;
+}
+
+void HostAllocationTracker::printReport(uint64_t framesRendered) const {
+    if (!trackingEnabled) return;
+    std::cout << "Host allocations (object/scope: live count and bytes, peak bytes, total allocations):" << std::endl;
+    for (const Category& category : categories) {
+        for (size_t scope = 0; scope < scopeCount; scope++) {
+            const Counters& counters = category.scopes[scope];
+            uint64_t total = counters.totalCount.load(std::memory_order_relaxed);
+            uint64_t internal = counters.internalBytes.load(std::memory_order_relaxed);
+            if (total == 0 && internal == 0) continue;
+
+            std::cout << "  " << hostAllocationObjectName(category.object) << "/" << scopeName(scope)
+                      << ": live " << counters.liveCount.load(std::memory_order_relaxed)
+                      << " (" << counters.liveBytes.load(std::memory_order_relaxed) << " B)"
+                      << ", peak " << counters.peakBytes.load(std::memory_order_relaxed) << " B"
+                      << ", " << total << " allocations";
+            if (framesStarted && framesRendered > 0) {
+                uint64_t duringFrames = total - counters.totalAtFrameStart;
+                std::cout << " (" << duringFrames << " while rendering, " << static_cast<double>(duringFrames) / framesRendered << " per frame)";
+            }
+            if (internal > 0) {
+                std::cout << ", " << internal << " B internal";
+            }
+            std::cout << std::endl;
+        }
+    }
+    if (poolingEnabled) {
+        for (const Pool& pool : pools) {
+            uint64_t hits = pool.hits.load(std::memory_order_relaxed);
+            if (hits > 0) {
+                std::cout << "  pool " << pool.blockSize << " B: " << hits << " allocations served, "
+                          << pool.chunks.size() * poolChunkBlocks << " blocks" << std::endl;
+            }
+        }
+    }
+}
@@ -0,0 +1,109 @@
+//
+//  helper_allocator.h
+//  VulkanTesting
+//
+//  VkAllocationCallbacks that count the driver's host allocations, and can serve the short-lived ones from pools.
+//
+
+#ifndef helper_allocator_h
+#define helper_allocator_h
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// The allocation callbacks don't say what object an allocation is for, only the scope. So every kind of object gets
+// callbacks of its own (pUserData tells them apart), and must be destroyed with the same ones it was created with.
+// Commands (vkQueueSubmit, vkAcquireNextImageKHR...) allocate through the callbacks of the device they run on
+enum class HostAllocationObject {
+    Instance,
+    Surface,
+    DebugMessenger,
+    Device,
+    Swapchain,
+    Image,
+    ImageView,
+    Memory,
+    Framebuffer,
+    RenderPass,
+    ShaderModule,
+    Pipeline,
+    CommandPool,
+    Semaphore,
+    Fence,
+    QueryPool,
+    Buffer,
+    Count
+};
+
+const char* hostAllocationObjectName(HostAllocationObject object);
+
+// Allocations are tracked per object kind and per VkSystemAllocationScope: live count and bytes, total allocations, and the highest
+// live byte count seen. What we want to find is churn on the frame path: command scope allocations made every frame by the submit
+// and present calls. With pooling on, small command and object scope allocations come from per-size free lists instead of malloc,
+// and go back to them when freed; the pools only grow, and are released when the tracker is destroyed
+class HostAllocationTracker {
+    public:
+    ~HostAllocationTracker();
+
+    // Off by default, and while off callbacks() returns nullptr so the driver uses its own allocator
+    void enable(bool pooling);
+    bool enabled() const { return trackingEnabled; }
+    // For vkCreate*/vkDestroy*/vkAllocateMemory/vkFreeMemory of the given kind of object, or nullptr when tracking is off
+    const VkAllocationCallbacks* callbacks(HostAllocationObject object) const;
+
+    // Counts allocations from here on separately, so the report can say how many were made per frame
+    void beginFrames();
+    void printReport(uint64_t framesRendered) const;
+
+    private:
+    static const size_t scopeCount = 5; // VkSystemAllocationScope values, COMMAND through INSTANCE
+
+    struct Counters {
+        std::atomic<uint64_t> liveCount{0};
+        std::atomic<uint64_t> liveBytes{0};
+        std::atomic<uint64_t> peakBytes{0};
+        std::atomic<uint64_t> totalCount{0};
+        std::atomic<uint64_t> internalBytes{0}; // reported through pfnInternalAllocation, allocated by the driver itself
+        uint64_t totalAtFrameStart = 0;
+    };
+    struct Category {
+        HostAllocationTracker* tracker;
+        HostAllocationObject object;
+        VkAllocationCallbacks callbacks;
+        std::array<Counters, scopeCount> scopes;
+    };
+    struct Pool {
+        size_t blockSize;
+        std::mutex mutex; // drivers may allocate from any thread we call them from. The lock is held for a pointer swap, nothing more
+        std::vector<void*> freeBlocks;
+        std::vector<void*> chunks; // what we got from malloc, freed in the destructor
+        std::atomic<uint64_t> hits{0};
+    };
+
+    bool trackingEnabled = false;
+    bool poolingEnabled = false;
+    std::array<Category, static_cast<size_t>(HostAllocationObject::Count)> categories;
+    std::array<Pool, 5> pools; // 64 to 1024 bytes, doubling
+    bool framesStarted = false;
+
+    void* allocate(Category& category, size_t size, size_t alignment, VkSystemAllocationScope scope);
+    void* reallocate(Category& category, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+    void release(void* memory);
+    void* allocateFromPool(size_t size, size_t alignment, VkSystemAllocationScope scope, uint8_t& poolIndex);
+    void count(Category& category, VkSystemAllocationScope scope, size_t size);
+    void uncount(Category& category, VkSystemAllocationScope scope, size_t size);
+
+    // The function pointers the driver calls, pUserData is the Category
+    static void* VKAPI_CALL allocationCallback(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope);
+    static void* VKAPI_CALL reallocationCallback(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+    static void VKAPI_CALL freeCallback(void* userData, void* memory);
+    static void VKAPI_CALL internalAllocationCallback(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+    static void VKAPI_CALL internalFreeCallback(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+};
+
+#endif /* helper_allocator_h */
@@ -0,0 +1,167 @@
+//
+//  helper_baseline.cpp
+//  VulkanTesting
+//
+//  Stored benchmark results to compare later runs against, for catching performance regressions.
+//
+#include "helper_baseline.h"
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+static void writeJsonString(std::ostream& out, const std::string& value) {
+    out << '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            out << '\\';
+        }
+        out << (static_cast<unsigned char>(c) < 0x20 ? ' ' : c);
+    }
+    out << '"';
+}
+
+void PerformanceBaseline::write(const std::string& path) const {
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        throw std::runtime_error("Failed to open baseline " + path);
+    }
+    out << "{" << std::endl;
+    out << "  \"scene\": ";
+    writeJsonString(out, scene);
+    out << "," << std::endl << "  \"device\": ";
+    writeJsonString(out, device);
+    for (const BaselineMetric& metric : metrics) {
+        out << "," << std::endl << "  ";
+        writeJsonString(out, metric.name);
+        out << ": " << std::setprecision(9) << metric.value;
+    }
+    out << std::endl << "}" << std::endl;
+    if (!out) {
+        throw std::runtime_error("Failed to write baseline " + path);
+    }
+}
+
+// Reads just the flat objects write() produces: string keys, string or number values. Anything else is an error rather than a guess
+class FlatJsonReader {
+    public:
+    FlatJsonReader(const std::string& text, const std::string& path) : text(text), path(path) {}
+
+    PerformanceBaseline parse() {
+        PerformanceBaseline baseline;
+        expect('{');
+        skipSpace();
+        if (peek() == '}') {
+            position++;
+            return baseline;
+        }
+        while (true) {
+            std::string key = parseString();
+            expect(':');
+            skipSpace();
+            if (peek() == '"') {
+                std::string value = parseString();
+                if (key == "scene") {
+                    baseline.scene = value;
+                } else if (key == "device") {
+                    baseline.device = value;
+                }
+            } else {
+                baseline.metrics.push_back({key, parseNumber(), false});
+            }
+            skipSpace();
+            if (peek() == ',') {
+                position++;
+                continue;
+            }
+            expect('}');
+            return baseline;
+        }
+    }
+
+    private:
+    const std::string& text;
+    const std::string& path;
+    size_t position = 0;
+
+    char peek() const { return position < text.size() ? text[position] : '\0'; }
+    void skipSpace() {
+        while (std::isspace(static_cast<unsigned char>(peek()))) {
+            position++;
+        }
+    }
+    [[noreturn]] void fail(const std::string& what) const {
+        throw std::runtime_error("Invalid baseline " + path + " at offset " + std::to_string(position) + ": " + what);
+    }
+    void expect(char c) {
+        skipSpace();
+        if (peek() != c) fail(std::string("expected '") + c + "'");
+        position++;
+    }
+    std::string parseString() {
+        expect('"');
+        std::string value;
+        while (peek() != '"') {
+            if (peek() == '\0') fail("unterminated string");
+            if (peek() == '\\') position++;
+            value += text[position++];
+        }
+        position++;
+        return value;
+    }
+    double parseNumber() {
+        const char* start = text.c_str() + position;
+        char* end = nullptr;
+        double value = std::strtod(start, &end);
+        if (end == start) fail("expected a string or a number");
+        position += end - start;
+        return value;
+    }
+};
+
+PerformanceBaseline PerformanceBaseline::read(const std::string& path) {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        throw std::runtime_error("Failed to open baseline " + path + ". Record one with --write-baseline");
+    }
+    std::stringstream contents;
+    contents << in.rdbuf();
+    std::string text = contents.str();
+    return FlatJsonReader(text, path).parse();
+}
+
+bool PerformanceBaseline::regressedFrom(const PerformanceBaseline& baseline, double tolerance) const {
+    if (baseline.device != device) {
+        std::cout << "Warning: the baseline was recorded on " << baseline.device << ", this run is on " << device << std::endl;
+    }
+    bool regressed = false;
+    std::cout << "Against the baseline (tolerance " << tolerance * 100.0 << "%):" << std::endl;
+    for (const BaselineMetric& metric : metrics) {
+        const BaselineMetric* stored = nullptr;
+        for (const BaselineMetric& candidate : baseline.metrics) {
+            if (candidate.name == metric.name) {
+                stored = &candidate;
+                break;
+            }
+        }
+        std::cout << "  " << metric.name << ": " << metric.value;
+        if (stored == nullptr) {
+            std::cout << " (not in the baseline)" << std::endl;
+            continue;
+        }
+        // Relative change, positive when we got worse
+        double change = stored->value != 0.0 ? (metric.value - stored->value) / stored->value : 0.0;
+        if (metric.higherIsBetter) {
+            change = -change;
+        }
+        bool worse = change > tolerance;
+        regressed = regressed || worse;
+        std::cout << ", baseline " << stored->value << " (" << std::fixed << std::setprecision(1) << std::fabs(change) * 100.0
+                  << (change > 0.0 ? "% worse)" : "% better)") << std::defaultfloat << std::setprecision(6) << (worse ? "  REGRESSION" : "") << std::endl;
+    }
+    return regressed;
+}
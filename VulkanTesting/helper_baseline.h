@@ -0,0 +1,38 @@
+//
+//  helper_baseline.h
+//  VulkanTesting
+//
+//  Stored benchmark results to compare later runs against, for catching performance regressions.
+//
+
+#ifndef helper_baseline_h
+#define helper_baseline_h
+#include <string>
+#include <vector>
+
+// One number a run is judged by
+struct BaselineMetric {
+    std::string name;
+    double value;
+    bool higherIsBetter; // throughput. Times are better lower
+};
+
+// A baseline only means something for the same scene on the same machine, so it remembers both. The scene has to match
+// to compare at all. A different device only warns: a driver update changing the numbers is exactly what we want to hear about
+class PerformanceBaseline {
+    public:
+    std::string scene;
+    std::string device;
+    std::vector<BaselineMetric> metrics;
+
+    // A flat JSON object: scene and device as strings, the metrics as numbers
+    void write(const std::string& path) const;
+    // Throws std::runtime_error if the file is missing or isn't something write() produced
+    static PerformanceBaseline read(const std::string& path);
+
+    // Prints a line per metric, ours against the baseline's. A metric regressed when it is worse by more than tolerance
+    // (0.1 = 10%). Metrics the baseline doesn't have are shown but can't regress. Returns whether anything regressed
+    bool regressedFrom(const PerformanceBaseline& baseline, double tolerance) const;
+};
+
+#endif /* helper_baseline_h */
@@ -0,0 +1,188 @@
+//
+//  helper_benchmark.cpp
+//  VulkanTesting
+//
+//  Fixed-frame benchmark runs: timings for a known number of frames, written out as JSON.
+//
+#include "helper_benchmark.h"
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+BenchmarkRecorder::BenchmarkRecorder(uint32_t warmupFrames, uint32_t measuredFrames)
+    : warmupFrames(warmupFrames), measuredFrames(measuredFrames) {
+}
+
+void BenchmarkRecorder::recordFrame(Clock::time_point frameStart, Clock::time_point frameEnd, double submitMs, double presentMs) {
+    if (!enabled()) return;
+
+    framesSeen++;
+    if (measuring() && framesSeen <= warmupFrames + measuredFrames) {
+        if (framesSeen == warmupFrames + 1) {
+            measureStart = frameStart;
+        }
+        // The first measured frame only has a predecessor to measure against if there was a warmup
+        if (framesSeen > 1) {
+            frameTimes.add(std::chrono::duration<double, std::milli>(frameStart - lastFrameStart).count());
+        }
+        cpuTimes.add(std::chrono::duration<double, std::milli>(frameEnd - frameStart).count());
+        submitTimes.add(submitMs);
+        if (presentMs >= 0.0) {
+            presentTimes.add(presentMs);
+        }
+    }
+    lastFrameStart = frameStart;
+}
+
+// There are only ever a handful of names, a linear search is fine
+static void addNamedSample(std::vector<std::pair<std::string, SampleStats>>& series, const std::string& name, double value) {
+    for (auto& entry : series) {
+        if (entry.first == name) {
+            entry.second.add(value);
+            return;
+        }
+    }
+    series.emplace_back(name, SampleStats(SampleStats::unbounded));
+    series.back().second.add(value);
+}
+
+// Frames are numbered from 1 in submission order, the same order recordFrame sees them in
+void BenchmarkRecorder::recordGpuTime(uint64_t frame, const std::string& scope, double milliseconds) {
+    if (isMeasuredFrame(frame)) {
+        addNamedSample(gpuTimes, scope, milliseconds);
+    }
+}
+
+void BenchmarkRecorder::recordGpuCounter(uint64_t frame, const std::string& counter, double value) {
+    if (isMeasuredFrame(frame)) {
+        addNamedSample(gpuCounters, counter, value);
+    }
+}
+
+void BenchmarkRecorder::finish() {
+    if (measuring()) {
+        measureEnd = Clock::now();
+    }
+}
+
+double BenchmarkRecorder::wallSeconds() const {
+    if (!measuring()) return 0.0;
+    return std::chrono::duration<double>(measureEnd - measureStart).count();
+}
+
+double BenchmarkRecorder::drawsPerSecond() const {
+    double wall = wallSeconds();
+    return wall > 0.0 ? static_cast<double>(drawsPerFrame) * cpuTimes.count() / wall : 0.0;
+}
+
+// Just enough JSON for our own strings: device names and such, no control characters expected but escape them anyway
+static void writeJsonString(std::ostream& out, const std::string& value) {
+    out << '"';
+    for (char c : value) {
+        switch (c) {
+            case '"': out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            case '\n': out << "\\n"; break;
+            case '\t': out << "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    out << ' ';
+                } else {
+                    out << c;
+                }
+        }
+    }
+    out << '"';
+}
+
+static void writeJsonStats(std::ostream& out, const char* name, const SampleStats& stats) {
+    out << "    \"" << name << "\": ";
+    if (stats.empty()) {
+        out << "null";
+        return;
+    }
+    out << "{\"count\": " << stats.count()
+        << ", \"mean\": " << stats.mean()
+        << ", \"p50\": " << stats.percentile(50)
+        << ", \"p95\": " << stats.percentile(95)
+        << ", \"p99\": " << stats.percentile(99)
+        << ", \"max\": " << stats.max() << "}";
+}
+
+static void writeJsonSeries(std::ostream& out, const char* name, const std::vector<std::pair<std::string, SampleStats>>& series) {
+    out << "  \"" << name << "\": {" << std::endl;
+    for (size_t i = 0; i < series.size(); i++) {
+        writeJsonStats(out, series[i].first.c_str(), series[i].second);
+        out << (i + 1 < series.size() ? "," : "") << std::endl;
+    }
+    out << "  }";
+}
+
+void BenchmarkRecorder::writeReport(const std::string& path) const {
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        throw std::runtime_error("Failed to open benchmark report " + path);
+    }
+
+    double wall = wallSeconds();
+    out << "{" << std::endl;
+    out << "  \"info\": {";
+    for (size_t i = 0; i < info.size(); i++) {
+        out << (i == 0 ? "" : ", ");
+        writeJsonString(out, info[i].first);
+        out << ": ";
+        writeJsonString(out, info[i].second);
+    }
+    out << "}," << std::endl;
+    out << "  \"warmup_frames\": " << warmupFrames << "," << std::endl;
+    out << "  \"measured_frames\": " << cpuTimes.count() << "," << std::endl;
+    out << "  \"wall_time_s\": " << wall << "," << std::endl;
+    out << "  \"fps\": " << (wall > 0.0 ? cpuTimes.count() / wall : 0.0) << "," << std::endl;
+    out << "  \"startup_ms\": " << startupMilliseconds << "," << std::endl;
+    out << "  \"draws_per_frame\": " << drawsPerFrame << "," << std::endl;
+    out << "  \"draws_per_s\": " << drawsPerSecond() << "," << std::endl;
+    out << "  \"timings_ms\": {" << std::endl;
+    writeJsonStats(out, "frame", frameTimes);
+    out << "," << std::endl;
+    writeJsonStats(out, "cpu_frame", cpuTimes);
+    out << "," << std::endl;
+    writeJsonStats(out, "submit", submitTimes);
+    out << "," << std::endl;
+    writeJsonStats(out, "present", presentTimes);
+    out << std::endl << "  }," << std::endl;
+    writeJsonSeries(out, "gpu_ms", gpuTimes);
+    out << "," << std::endl;
+    writeJsonSeries(out, "gpu_counters", gpuCounters);
+    out << std::endl;
+    out << "}" << std::endl;
+
+    if (!out) {
+        throw std::runtime_error("Failed to write benchmark report " + path);
+    }
+}
+
+std::vector<BaselineMetric> BenchmarkRecorder::baselineMetrics() const {
+    // Medians rather than means or tails: one hiccup from whatever else the machine is doing shouldn't fail the check
+    std::vector<BaselineMetric> metrics;
+    metrics.push_back({"startup_ms", startupMilliseconds, false});
+    metrics.push_back({"frame_p50_ms", frameTimes.empty() ? 0.0 : frameTimes.percentile(50), false});
+    metrics.push_back({"cpu_frame_p50_ms", cpuTimes.empty() ? 0.0 : cpuTimes.percentile(50), false});
+    metrics.push_back({"draws_per_s", drawsPerSecond(), true});
+    return metrics;
+}
+
+void BenchmarkRecorder::printSummary() const {
+    if (!enabled()) return;
+    std::cout << "Benchmark: " << cpuTimes.count() << " frames in " << wallSeconds() << " s"
+              << ", frame time ms p50=" << frameTimes.percentile(50)
+              << " p95=" << frameTimes.percentile(95)
+              << " p99=" << frameTimes.percentile(99)
+              << " max=" << frameTimes.max() << std::endl;
+    std::cout << "  startup " << startupMilliseconds << " ms, " << drawsPerSecond() << " draws/s (" << drawsPerFrame << " per frame)" << std::endl;
+    for (const auto& entry : gpuTimes) {
+        std::cout << "  GPU " << entry.first << " ms p50=" << entry.second.percentile(50)
+                  << " p95=" << entry.second.percentile(95)
+                  << " p99=" << entry.second.percentile(99)
+                  << " max=" << entry.second.max() << std::endl;
+    }
+}
@@ -0,0 +1,74 @@
+//
+//  helper_benchmark.h
+//  VulkanTesting
+//
+//  Fixed-frame benchmark runs: timings for a known number of frames, written out as JSON.
+//
+
+#ifndef helper_benchmark_h
+#define helper_benchmark_h
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "helper_baseline.h"
+#include "helper_stats.h"
+
+// The first warmupFrames frames are rendered but not measured: pipelines, caches and clocks need a moment to settle.
+// Of the measuredFrames after that, we keep every frame's timings so the report can give percentiles rather than just an average
+class BenchmarkRecorder {
+    public:
+    typedef std::chrono::steady_clock Clock;
+
+    // measuredFrames == 0 disables recording
+    BenchmarkRecorder(uint32_t warmupFrames, uint32_t measuredFrames);
+
+    bool enabled() const { return measuredFrames > 0; }
+    // Call once per frame that was actually submitted, with when its CPU work started and ended and how long the submit/present calls took.
+    // presentMs < 0 means nothing was presented (headless)
+    void recordFrame(Clock::time_point frameStart, Clock::time_point frameEnd, double submitMs, double presentMs);
+    // GPU timings are read back a few frames late, so they say which frame they belong to instead of counting as the current one
+    void recordGpuTime(uint64_t frame, const std::string& scope, double milliseconds);
+    // Same, for GPU counters such as pipeline statistics
+    void recordGpuCounter(uint64_t frame, const std::string& counter, double value);
+    // Call once the GPU has finished everything, so the wall time includes the last frames
+    void finish();
+    // From starting up until ready to draw the first frame
+    void setStartupMilliseconds(double milliseconds) { startupMilliseconds = milliseconds; }
+    // Draw calls in each frame's command buffer, for the draw call throughput
+    void setDrawsPerFrame(uint32_t draws) { drawsPerFrame = draws; }
+
+    // Free-form "key": "value" pairs describing the run (device, mode...), written first in the report
+    void addInfo(const std::string& key, const std::string& value) { info.emplace_back(key, value); }
+    void writeReport(const std::string& path) const;
+    void printSummary() const;
+    // What a regression check compares: startup time, median frame and CPU frame times, and draw call throughput
+    std::vector<BaselineMetric> baselineMetrics() const;
+
+    private:
+    uint32_t warmupFrames;
+    uint32_t measuredFrames;
+    uint32_t framesSeen = 0;
+    Clock::time_point lastFrameStart;
+    Clock::time_point measureStart; // start of the first measured frame
+    Clock::time_point measureEnd;
+    double startupMilliseconds = 0.0;
+    uint32_t drawsPerFrame = 1;
+
+    // Every measured frame is kept: there are only ever measuredFrames of them, and the report wants all of them
+    SampleStats frameTimes{SampleStats::unbounded};  // ms between the starts of consecutive frames, what a user would call the frame time
+    SampleStats cpuTimes{SampleStats::unbounded};    // ms the CPU spent inside a frame, including waiting for a free frame in flight
+    SampleStats submitTimes{SampleStats::unbounded}; // ms spent in vkQueueSubmit
+    SampleStats presentTimes{SampleStats::unbounded}; // ms spent in vkQueuePresentKHR
+    std::vector<std::pair<std::string, SampleStats>> gpuTimes; // ms per GPU profiler scope
+    std::vector<std::pair<std::string, SampleStats>> gpuCounters;
+    std::vector<std::pair<std::string, std::string>> info;
+
+    bool measuring() const { return framesSeen > warmupFrames; }
+    bool isMeasuredFrame(uint64_t frame) const { return enabled() && frame > warmupFrames && frame <= warmupFrames + measuredFrames; }
+    double wallSeconds() const;
+    double drawsPerSecond() const;
+};
+
+#endif /* helper_benchmark_h */
@@ -0,0 +1,149 @@
+//
+//  helper_capabilities.cpp
+//  VulkanTesting
+//
+//  Everything we want to know about the Vulkan installation and each GPU, queried once.
+//
+#include "helper_capabilities.h"
+#include "helper_extensions.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+static bool containsExtension(const std::vector<VkExtensionProperties>& extensions, const char* name) {
+    for (const auto& extension : extensions) {
+        if (strcmp(extension.extensionName, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool InstanceCapabilities::hasExtension(const char* name) const {
+    return containsExtension(extensions, name);
+}
+
+bool InstanceCapabilities::hasExtensions(const std::vector<const char*>& names) const {
+    for (const char* name : names) {
+        if (!hasExtension(name)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool InstanceCapabilities::hasLayer(const char* name) const {
+    for (const auto& layer : layers) {
+        if (strcmp(layer.layerName, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool InstanceCapabilities::hasLayerExtension(const char* name) const {
+    return containsExtension(layerExtensions, name);
+}
+
+InstanceCapabilities queryInstanceCapabilities(const std::vector<const char*>& layersOfInterest) {
+    InstanceCapabilities capabilities;
+    auto enumerateVersion = (PFN_vkEnumerateInstanceVersion) vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion");
+    if (enumerateVersion != nullptr) {
+        enumerateVersion(&capabilities.apiVersion);
+    }
+    capabilities.extensions = listVulkanSupportedExtensions();
+
+    uint32_t layerCount = 0;
+    vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
+    capabilities.layers.resize(layerCount);
+    vkEnumerateInstanceLayerProperties(&layerCount, capabilities.layers.data());
+
+    for (const char* layerName : layersOfInterest) {
+        if (!capabilities.hasLayer(layerName)) continue;
+        uint32_t extensionCount = 0;
+        vkEnumerateInstanceExtensionProperties(layerName, &extensionCount, nullptr);
+        std::vector<VkExtensionProperties> extensions(extensionCount);
+        vkEnumerateInstanceExtensionProperties(layerName, &extensionCount, extensions.data());
+        capabilities.layerExtensions.insert(capabilities.layerExtensions.end(), extensions.begin(), extensions.end());
+    }
+
+    return capabilities;
+}
+
+bool DeviceCapabilities::hasExtension(const char* name) const {
+    return containsExtension(extensions, name);
+}
+
+bool DeviceCapabilities::hasExtensions(const std::vector<const char*>& names) const {
+    for (const char* name : names) {
+        if (!hasExtension(name)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+DeviceCapabilities queryDeviceCapabilities(VkInstance instance, VkPhysicalDevice device, uint32_t instanceApiVersion) {
+    DeviceCapabilities capabilities;
+    capabilities.device = device;
+    vkGetPhysicalDeviceProperties(device, &capabilities.properties);
+    vkGetPhysicalDeviceFeatures(device, &capabilities.features);
+    vkGetPhysicalDeviceMemoryProperties(device, &capabilities.memoryProperties);
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+    capabilities.queueFamilies.resize(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, capabilities.queueFamilies.data());
+
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+    capabilities.extensions.resize(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, capabilities.extensions.data());
+
+    // Extension features need vkGetPhysicalDeviceFeatures2, which on 1.0 comes from an instance extension.
+    // Only structs for extensions the device actually has may go in the chain
+    auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR) vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR");
+    uint32_t apiVersion = std::min(instanceApiVersion, capabilities.properties.apiVersion);
+    capabilities.optionalFeatures = queryOptionalFeatures(getFeatures2, device, apiVersion, capabilities.extensions);
+    if (getFeatures2 == nullptr) {
+        return capabilities;
+    }
+    // The present extensions only matter with a window, so they're not in the optional feature table
+    VkPhysicalDeviceFeatures2KHR features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+    void** next = &features.pNext;
+
+    VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {};
+    presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    if (capabilities.hasExtension(VK_KHR_PRESENT_ID_EXTENSION_NAME)) {
+        *next = &presentIdFeatures;
+        next = &presentIdFeatures.pNext;
+    }
+    VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {};
+    presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+    if (capabilities.hasExtension(VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+        *next = &presentWaitFeatures;
+        next = &presentWaitFeatures.pNext;
+    }
+    VkPhysicalDeviceSwapchainMaintenance1FeaturesEXT swapchainMaintenanceFeatures = {};
+    swapchainMaintenanceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SWAPCHAIN_MAINTENANCE_1_FEATURES_EXT;
+    if (capabilities.hasExtension(VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME)) {
+        *next = &swapchainMaintenanceFeatures;
+        next = &swapchainMaintenanceFeatures.pNext;
+    }
+    getFeatures2(device, &features);
+
+    capabilities.presentId = presentIdFeatures.presentId == VK_TRUE;
+    capabilities.presentWait = presentWaitFeatures.presentWait == VK_TRUE;
+    capabilities.swapchainMaintenance1 = swapchainMaintenanceFeatures.swapchainMaintenance1 == VK_TRUE;
+    return capabilities;
+}
+
+void printDeviceCapabilities(const DeviceCapabilities& capabilities) {
+    const VkPhysicalDeviceProperties& properties = capabilities.properties;
+    std::ios_base::fmtflags f( std::cout.flags()); // Save std flags to restore them later. Changing output to hex is stateful
+    std::cout << properties.deviceName << ". DeviceId=" << properties.deviceID << ". VendorId=0x" << std::hex << properties.vendorID << ". API version=" << std::dec << formatApiVersion(properties.apiVersion)
+              << ". Queue families=" << capabilities.queueFamilies.size() << ". Extensions=" << capabilities.extensions.size() << std::endl;
+    std::cout.flags(f);
+    printOptionalFeatures(capabilities.optionalFeatures);
+}
@@ -0,0 +1,61 @@
+//
+//  helper_capabilities.h
+//  VulkanTesting
+//
+//  Everything we want to know about the Vulkan installation and each GPU, queried once.
+//
+
+#ifndef helper_capabilities_h
+#define helper_capabilities_h
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vector>
+#include "helper_features.h"
+
+// Enumerating extensions and layers goes through the loader and every layer's manifest, so it isn't free.
+// We do it once at startup and everything else (instance creation, validation checks, logging) reads from here
+struct InstanceCapabilities {
+    uint32_t apiVersion = VK_API_VERSION_1_0; // the loader's. 1.0 loaders don't have vkEnumerateInstanceVersion
+    std::vector<VkExtensionProperties> extensions;
+    std::vector<VkLayerProperties> layers;
+    // Extensions implemented by the layers we asked about (e.g. VK_EXT_validation_features), only usable with their layer enabled
+    std::vector<VkExtensionProperties> layerExtensions;
+
+    bool hasExtension(const char* name) const;
+    bool hasExtensions(const std::vector<const char*>& names) const;
+    bool hasLayer(const char* name) const;
+    bool hasLayerExtension(const char* name) const;
+};
+
+// layersOfInterest: layers we may enable, whose own extensions should be listed too. Absent ones are skipped
+InstanceCapabilities queryInstanceCapabilities(const std::vector<const char*>& layersOfInterest = {});
+
+// Same idea for a physical device: everything device selection and device creation need, queried once per GPU.
+// Surface-dependent details (present support, formats, present modes) are not in here since they change with the surface
+struct DeviceCapabilities {
+    VkPhysicalDevice device = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties properties;
+    VkPhysicalDeviceFeatures features;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    std::vector<VkQueueFamilyProperties> queueFamilies;
+    std::vector<VkExtensionProperties> extensions;
+
+    // Newer versions' features, and the extensions that bring them to older ones. See helper_features
+    OptionalFeatures optionalFeatures;
+
+    // Extension features, only true if the extension is there and the feature is supported
+    bool presentId = false;
+    bool presentWait = false;
+    bool swapchainMaintenance1 = false; // present fences, among other things
+
+    bool hasExtension(const char* name) const;
+    bool hasExtensions(const std::vector<const char*>& names) const;
+};
+
+// The instance must have VK_KHR_get_physical_device_properties2 enabled, extension features are queried through it.
+// instanceApiVersion is the one the instance was created with, the device can't be used beyond it
+DeviceCapabilities queryDeviceCapabilities(VkInstance instance, VkPhysicalDevice device, uint32_t instanceApiVersion);
+
+void printDeviceCapabilities(const DeviceCapabilities& capabilities);
+
+#endif /* helper_capabilities_h */
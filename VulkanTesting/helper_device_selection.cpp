@@ -0,0 +1,152 @@
+//
+//  helper_device_selection.cpp
+//  VulkanTesting
+//
+//  Choosing a GPU: scoring the candidates, picking one by index or UUID, and remembering the choice between runs.
+//
+#include "helper_device_selection.h"
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+std::string formatDeviceUUID(const DeviceUUID& uuid) {
+    static const char digits[] = "0123456789abcdef";
+    std::string text;
+    for (uint8_t byte : uuid) {
+        text += digits[byte >> 4];
+        text += digits[byte & 0xf];
+    }
+    return text;
+}
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool parseDeviceUUID(const std::string& text, DeviceUUID& uuid) {
+    size_t nibble = 0;
+    for (char c : text) {
+        if (c == '-') continue;
+        int value = hexValue(c);
+        if (value < 0 || nibble >= uuid.size() * 2) return false;
+        if (nibble % 2 == 0) {
+            uuid[nibble / 2] = static_cast<uint8_t>(value << 4);
+        } else {
+            uuid[nibble / 2] |= static_cast<uint8_t>(value);
+        }
+        nibble++;
+    }
+    return nibble == uuid.size() * 2;
+}
+
+bool queryDeviceUUID(VkInstance instance, VkPhysicalDevice device, DeviceUUID& uuid) {
+    auto getProperties2 = (PFN_vkGetPhysicalDeviceProperties2KHR) vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceProperties2KHR");
+    if (getProperties2 == nullptr) return false;
+
+    VkPhysicalDeviceIDPropertiesKHR idProperties = {};
+    idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES_KHR;
+    VkPhysicalDeviceProperties2KHR properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+    properties.pNext = &idProperties;
+    getProperties2(device, &properties);
+    std::copy(std::begin(idProperties.deviceUUID), std::end(idProperties.deviceUUID), uuid.begin());
+    return true;
+}
+
+DeviceScore scoreDevice(const DeviceCapabilities& capabilities) {
+    DeviceScore score;
+    switch (capabilities.properties.deviceType) {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: score.type = 10000.0; break;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: score.type = 5000.0; break;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: score.type = 2500.0; break;
+        case VK_PHYSICAL_DEVICE_TYPE_CPU: score.type = 100.0; break;
+        default: break;
+    }
+
+    // 100 per GiB, capped at 32 GiB so memory alone can't lift a device into the next type. Integrated GPUs often report
+    // system memory as device local, the cap keeps that from mattering much either
+    VkDeviceSize largestHeap = 0;
+    const VkPhysicalDeviceMemoryProperties& memory = capabilities.memoryProperties;
+    for (uint32_t i = 0; i < memory.memoryHeapCount; i++) {
+        if ((memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && memory.memoryHeaps[i].size > largestHeap) {
+            largestHeap = memory.memoryHeaps[i].size;
+        }
+    }
+    double gibibytes = largestHeap / (1024.0 * 1024.0 * 1024.0);
+    score.memory = 100.0 * (gibibytes < 32.0 ? gibibytes : 32.0);
+
+    // A transfer-only family usually means a DMA engine, a compute-only one async compute
+    for (const VkQueueFamilyProperties& family : capabilities.queueFamilies) {
+        bool graphics = family.queueFlags & VK_QUEUE_GRAPHICS_BIT;
+        bool compute = family.queueFlags & VK_QUEUE_COMPUTE_BIT;
+        if (!graphics && !compute && (family.queueFlags & VK_QUEUE_TRANSFER_BIT)) {
+            score.queues += 300.0;
+        } else if (!graphics && compute) {
+            score.queues += 300.0;
+        } else if (graphics && family.queueCount > 1) {
+            score.queues += 100.0;
+        }
+    }
+    if (score.queues > 700.0) {
+        score.queues = 700.0; // several of the same kind of family don't help us more than one
+    }
+
+    const VkPhysicalDeviceLimits& limits = capabilities.properties.limits;
+    if (limits.timestampComputeAndGraphics) {
+        score.limits += 100.0; // the GPU profiler needs it
+    }
+    if (capabilities.features.pipelineStatisticsQuery) {
+        score.limits += 50.0;
+    }
+    double imageSize = limits.maxImageDimension2D / 1024.0; // bigger windows before the swapchain extent has to be clamped
+    score.limits += 10.0 * (imageSize < 16.0 ? imageSize : 16.0);
+    return score;
+}
+
+void printDeviceScore(const DeviceScore& score) {
+    std::cout << "score " << score.total() << " (type " << score.type << ", memory " << score.memory
+              << ", queues " << score.queues << ", limits " << score.limits << ")" << std::endl;
+}
+
+std::string defaultDeviceCachePath() {
+    const char* cacheHome = std::getenv("XDG_CACHE_HOME");
+    if (cacheHome != nullptr && cacheHome[0] != '\0') {
+        return std::string(cacheHome) + "/VulkanTesting/device";
+    }
+    const char* home = std::getenv("HOME");
+    if (home != nullptr && home[0] != '\0') {
+        return std::string(home) + "/.cache/VulkanTesting/device";
+    }
+    return "";
+}
+
+bool readCachedDevice(const std::string& path, DeviceUUID& uuid, uint32_t& deviceCount) {
+    std::ifstream in(path);
+    std::string text;
+    return in >> text >> deviceCount && parseDeviceUUID(text, uuid); // the device name after them is only for whoever opens the file
+}
+
+void writeCachedDevice(const std::string& path, const DeviceUUID& uuid, uint32_t deviceCount, const char* deviceName) {
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+    std::ofstream out(path);
+    out << formatDeviceUUID(uuid) << " " << deviceCount << " " << deviceName << std::endl;
+    if (!out) {
+        std::cout << "Warning: could not write the device cache " << path << std::endl;
+    }
+}
+
+bool driversRestricted() {
+    for (const char* name : {"VK_DRIVER_FILES", "VK_ICD_FILENAMES"}) {
+        const char* value = std::getenv(name);
+        if (value != nullptr && value[0] != '\0') {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,51 @@
+//
+//  helper_device_selection.h
+//  VulkanTesting
+//
+//  Choosing a GPU: scoring the candidates, picking one by index or UUID, and remembering the choice between runs.
+//
+
+#ifndef helper_device_selection_h
+#define helper_device_selection_h
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <array>
+#include <cstdint>
+#include <string>
+#include "helper_capabilities.h"
+
+// deviceUUID from VkPhysicalDeviceIDProperties. Unlike the enumeration index it stays the same when GPUs are added, removed or
+// reordered, and it's what vulkaninfo and nvidia-smi show, so it's the way to name a device from the command line
+typedef std::array<uint8_t, VK_UUID_SIZE> DeviceUUID;
+
+std::string formatDeviceUUID(const DeviceUUID& uuid);
+// 32 hex digits, dashes anywhere are ignored so the 8-4-4-4-12 form works too
+bool parseDeviceUUID(const std::string& text, DeviceUUID& uuid);
+// Just the UUID, without querying everything else. Needs VK_KHR_external_memory_capabilities enabled on the instance
+bool queryDeviceUUID(VkInstance instance, VkPhysicalDevice device, DeviceUUID& uuid);
+
+// Higher is better. Parts are weighted so the device type always wins: the best integrated GPU still loses to any discrete one,
+// and a software rasterizer only gets picked when there's nothing else
+struct DeviceScore {
+    double type = 0.0;   // discrete > integrated > virtual > CPU
+    double memory = 0.0; // largest device local heap
+    double queues = 0.0; // dedicated transfer and compute families, more than one graphics queue
+    double limits = 0.0; // the few limits and features we actually use
+    double total() const { return type + memory + queues + limits; }
+};
+
+DeviceScore scoreDevice(const DeviceCapabilities& capabilities);
+void printDeviceScore(const DeviceScore& score);
+
+// Where the last chosen device's UUID is kept: $XDG_CACHE_HOME/VulkanTesting/device, or ~/.cache/VulkanTesting/device.
+// Empty if neither variable is set
+std::string defaultDeviceCachePath();
+// deviceCount is how many GPUs there were to choose from. If that changed since, the choice should be made again
+bool readCachedDevice(const std::string& path, DeviceUUID& uuid, uint32_t& deviceCount);
+// Best effort: a cache we can't write just means scoring again next time
+void writeCachedDevice(const std::string& path, const DeviceUUID& uuid, uint32_t deviceCount, const char* deviceName);
+// Whether the loader was told to only load some drivers (VK_DRIVER_FILES, or VK_ICD_FILENAMES on older loaders). A choice made
+// among those isn't one to remember: the next run without them could pick a better GPU
+bool driversRestricted();
+
+#endif /* helper_device_selection_h */
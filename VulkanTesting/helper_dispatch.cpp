@@ -0,0 +1,56 @@
+//
+//  helper_dispatch.cpp
+//  VulkanTesting
+//
+//  Device-level Vulkan functions loaded straight from the driver, for the calls we make every frame.
+//
+#include "helper_dispatch.h"
+#include <stdexcept>
+#include <string>
+
+template <typename Function>
+static void loadFunction(VkDevice device, Function& function, const char* name, bool required) {
+    function = reinterpret_cast<Function>(vkGetDeviceProcAddr(device, name));
+    if (function == nullptr && required) {
+        throw std::runtime_error(std::string("Failed to load device function ") + name);
+    }
+}
+
+// Spares writing every name twice, once as the member and once as the string
+#define LOAD_DEVICE_FUNCTION(name, required) loadFunction(device, name, #name, required)
+
+void DeviceDispatch::load(VkDevice device, const OptionalFeatures& features, bool swapchain, bool presentWait) {
+    LOAD_DEVICE_FUNCTION(vkBeginCommandBuffer, true);
+    LOAD_DEVICE_FUNCTION(vkEndCommandBuffer, true);
+    LOAD_DEVICE_FUNCTION(vkCmdBeginRenderPass, true);
+    LOAD_DEVICE_FUNCTION(vkCmdEndRenderPass, true);
+    LOAD_DEVICE_FUNCTION(vkCmdBindPipeline, true);
+    LOAD_DEVICE_FUNCTION(vkCmdSetViewport, true);
+    LOAD_DEVICE_FUNCTION(vkCmdSetScissor, true);
+    LOAD_DEVICE_FUNCTION(vkCmdBindVertexBuffers, true);
+    LOAD_DEVICE_FUNCTION(vkCmdDraw, true);
+    LOAD_DEVICE_FUNCTION(vkCmdDrawIndirect, true);
+
+    LOAD_DEVICE_FUNCTION(vkCmdResetQueryPool, true);
+    LOAD_DEVICE_FUNCTION(vkCmdWriteTimestamp, true);
+    LOAD_DEVICE_FUNCTION(vkCmdBeginQuery, true);
+    LOAD_DEVICE_FUNCTION(vkCmdEndQuery, true);
+    LOAD_DEVICE_FUNCTION(vkGetQueryPoolResults, true);
+
+    LOAD_DEVICE_FUNCTION(vkQueueSubmit, true);
+    // On 1.2 the feature chain doesn't enable the extension, so only the core names exist
+    bool timelineCore = features.apiVersion >= VK_API_VERSION_1_2;
+    loadFunction(device, vkWaitSemaphoresKHR, timelineCore ? "vkWaitSemaphores" : "vkWaitSemaphoresKHR", true);
+    loadFunction(device, vkGetSemaphoreCounterValueKHR, timelineCore ? "vkGetSemaphoreCounterValue" : "vkGetSemaphoreCounterValueKHR", true);
+
+    // Extension functions only exist if their extension was enabled on the device, asking for the others would give nullptr anyway
+    if (swapchain) {
+        LOAD_DEVICE_FUNCTION(vkAcquireNextImageKHR, true);
+        LOAD_DEVICE_FUNCTION(vkQueuePresentKHR, true);
+    }
+    if (presentWait) {
+        LOAD_DEVICE_FUNCTION(vkWaitForPresentKHR, false); // optional: without it we just don't pace on presents
+    }
+}
+
+#undef LOAD_DEVICE_FUNCTION
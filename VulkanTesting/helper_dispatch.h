@@ -0,0 +1,55 @@
+//
+//  helper_dispatch.h
+//  VulkanTesting
+//
+//  Device-level Vulkan functions loaded straight from the driver, for the calls we make every frame.
+//
+
+#ifndef helper_dispatch_h
+#define helper_dispatch_h
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include "helper_features.h"
+
+// The functions the loader exports are trampolines: they look up the device's dispatch table and jump to the driver from there.
+// vkGetDeviceProcAddr hands out the driver's own function instead (or the first layer's, with validation on), so calling through
+// these pointers skips a jump per call. Nothing to notice for a handful of calls, but it adds up with thousands of commands per frame.
+// Members are named like the functions they point to, the way meta-loaders such as volk do it: swapping vkCmdDraw for
+// dispatch.vkCmdDraw is all it takes to move a call over. Only valid for the device they were loaded for
+struct DeviceDispatch {
+    // Command buffer recording
+    PFN_vkBeginCommandBuffer vkBeginCommandBuffer = nullptr;
+    PFN_vkEndCommandBuffer vkEndCommandBuffer = nullptr;
+    PFN_vkCmdBeginRenderPass vkCmdBeginRenderPass = nullptr;
+    PFN_vkCmdEndRenderPass vkCmdEndRenderPass = nullptr;
+    PFN_vkCmdBindPipeline vkCmdBindPipeline = nullptr;
+    PFN_vkCmdSetViewport vkCmdSetViewport = nullptr;
+    PFN_vkCmdSetScissor vkCmdSetScissor = nullptr;
+    PFN_vkCmdBindVertexBuffers vkCmdBindVertexBuffers = nullptr;
+    PFN_vkCmdDraw vkCmdDraw = nullptr;
+    PFN_vkCmdDrawIndirect vkCmdDrawIndirect = nullptr;
+
+    // Queries, for the GPU profiler
+    PFN_vkCmdResetQueryPool vkCmdResetQueryPool = nullptr;
+    PFN_vkCmdWriteTimestamp vkCmdWriteTimestamp = nullptr;
+    PFN_vkCmdBeginQuery vkCmdBeginQuery = nullptr;
+    PFN_vkCmdEndQuery vkCmdEndQuery = nullptr;
+    PFN_vkGetQueryPoolResults vkGetQueryPoolResults = nullptr;
+
+    // Submission and timeline semaphores. The KHR ones aren't exported by the loader at all, so they always came from here.
+    // From 1.2 on they point to the core functions, which take the same arguments
+    PFN_vkQueueSubmit vkQueueSubmit = nullptr;
+    PFN_vkWaitSemaphoresKHR vkWaitSemaphoresKHR = nullptr;
+    PFN_vkGetSemaphoreCounterValueKHR vkGetSemaphoreCounterValueKHR = nullptr;
+
+    // VK_KHR_swapchain, nullptr when headless
+    PFN_vkAcquireNextImageKHR vkAcquireNextImageKHR = nullptr;
+    PFN_vkQueuePresentKHR vkQueuePresentKHR = nullptr;
+    // VK_KHR_present_wait, nullptr when not enabled
+    PFN_vkWaitForPresentKHR vkWaitForPresentKHR = nullptr;
+
+    // Right after vkCreateDevice, with what was enabled on it. Throws if anything the device must have is missing
+    void load(VkDevice device, const OptionalFeatures& features, bool swapchain, bool presentWait);
+};
+
+#endif /* helper_dispatch_h */
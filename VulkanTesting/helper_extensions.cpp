@@ -25,10 +25,9 @@ const std::vector<VkExtensionProperties> listVulkanSupportedExtensions(uint32_t*
     return extensions;
 }
 
-void printVulkanSupportedExtensions() {
-    uint32_t extensionCount = 0;
-    const std::vector<VkExtensionProperties> extensions = listVulkanSupportedExtensions(&extensionCount);
-    std::cout << "Available extensions: " << extensionCount << std::endl;
+// Takes the list instead of enumerating it again, see InstanceCapabilities
+void printVulkanSupportedExtensions(const std::vector<VkExtensionProperties>& extensions) {
+    std::cout << "Available extensions: " << extensions.size() << std::endl;
     // "const auto&" lets us access the values without a copy (&), and prevents their accidental modification (const)
     for (const auto& extension: extensions) {
         std::cout << "--\t" << extension.extensionName << std::endl;
@@ -58,12 +57,10 @@ void printGlfwRequiredExtensions() {
     }
 }
 
-bool checkGlfwRequiredExtensionsAvailable() {
+bool checkGlfwRequiredExtensionsAvailable(const std::vector<VkExtensionProperties>& vulkanExtensions) {
     uint32_t glfwExtensionCount = 0;
-    uint32_t vulkanExtensionCount = 0;
     uint32_t matchingExtensions = 0;
     const std::vector<const char*> glfwExtensions = listGlfwRequiredExtensions(&glfwExtensionCount);
-    const std::vector<VkExtensionProperties> vulkanExtensions = listVulkanSupportedExtensions(&vulkanExtensionCount);
 
     for (int i = 0; i < glfwExtensionCount; i++) {
         for (const auto& vulkanExtension: vulkanExtensions) {
@@ -82,8 +79,16 @@ const std::vector<const char*> listDebugRequiredExtensions() {
     return extensions;
 }
 
-const std::vector<const char*> listRequiredExtensions(bool debug) {
-    std::vector<const char*> extensions = listGlfwRequiredExtensions();
+const std::vector<const char*> listRequiredExtensions(bool debug, bool windowed) {
+    std::vector<const char*> extensions;
+    
+    // Without a window there is no surface, so none of the WSI extensions GLFW asks for are needed (and GLFW isn't even initialized)
+    if (windowed) {
+        extensions = listGlfwRequiredExtensions();
+    }
+    
+    // Needed to query extension features (vkGetPhysicalDeviceFeatures2KHR) on a 1.0 instance, e.g. timeline semaphore support
+    extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
     
     if (debug) {
         std::vector<const char*> debugExtensions = listDebugRequiredExtensions();
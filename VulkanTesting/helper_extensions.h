@@ -16,9 +16,9 @@
 #endif /* helper_extensions_h */
 
 const std::vector<VkExtensionProperties> listVulkanSupportedExtensions(uint32_t* count = nullptr);
-void printVulkanSupportedExtensions();
+void printVulkanSupportedExtensions(const std::vector<VkExtensionProperties>& extensions);
 const std::vector<const char*> listGlfwRequiredExtensions(uint32_t* count = nullptr);
 void printGlfwRequiredExtensions();
-bool checkGlfwRequiredExtensionsAvailable();
+bool checkGlfwRequiredExtensionsAvailable(const std::vector<VkExtensionProperties>& vulkanExtensions);
 const std::vector<const char*> listDebugRequiredExtensions();
-const std::vector<const char*> listRequiredExtensions(bool debug = false);
+const std::vector<const char*> listRequiredExtensions(bool debug = false, bool windowed = true);
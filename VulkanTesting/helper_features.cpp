@@ -0,0 +1,173 @@
+//
+//  helper_features.cpp
+//  VulkanTesting
+//
+//  Optional Vulkan versions, extensions and features: what we ask for, and what the device ends up with.
+//
+#include "helper_features.h"
+#include "helper_capabilities.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+
+// An extension our extension needs. Only below the version it became core in, from then on there's nothing to enable
+struct ExtensionDependency {
+    const char* name; // nullptr if there's no device extension that covers it (e.g. it needs an instance extension too): the version or nothing
+    uint32_t coreVersion;
+};
+
+// One optional feature: where it comes from, and how to ask the device for it
+struct OptionalFeature {
+    const char* name;
+    bool OptionalFeatures::* flag;
+    uint32_t coreVersion; // promoted to core in this version
+    const char* extension; // provides it on older versions
+    std::vector<ExtensionDependency> dependencies;
+    VkStructureType structureType; // its VkPhysicalDevice*Features struct, for both querying and enabling
+    size_t structureSize;
+    std::vector<size_t> members; // the VkBool32s in that struct we need. All of them, or the feature counts as missing
+};
+
+// Adding a feature is adding an entry here and a flag to OptionalFeatures. The KHR/EXT structs are the same types as their core
+// counterparts, so one struct serves both ways of getting a feature
+static const std::vector<OptionalFeature> optionalFeatureTable = {
+    {"timeline_semaphore", &OptionalFeatures::timelineSemaphore, VK_API_VERSION_1_2, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME, {},
+     VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR, sizeof(VkPhysicalDeviceTimelineSemaphoreFeaturesKHR),
+     {offsetof(VkPhysicalDeviceTimelineSemaphoreFeaturesKHR, timelineSemaphore)}},
+    {"synchronization2", &OptionalFeatures::synchronization2, VK_API_VERSION_1_3, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME, {},
+     VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR, sizeof(VkPhysicalDeviceSynchronization2FeaturesKHR),
+     {offsetof(VkPhysicalDeviceSynchronization2FeaturesKHR, synchronization2)}},
+    {"dynamic_rendering", &OptionalFeatures::dynamicRendering, VK_API_VERSION_1_3, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME,
+     {{VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME, VK_API_VERSION_1_2}, {VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME, VK_API_VERSION_1_2},
+      {VK_KHR_MULTIVIEW_EXTENSION_NAME, VK_API_VERSION_1_1}, {VK_KHR_MAINTENANCE_2_EXTENSION_NAME, VK_API_VERSION_1_1}},
+     VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR, sizeof(VkPhysicalDeviceDynamicRenderingFeaturesKHR),
+     {offsetof(VkPhysicalDeviceDynamicRenderingFeaturesKHR, dynamicRendering)}},
+    {"descriptor_indexing", &OptionalFeatures::descriptorIndexing, VK_API_VERSION_1_2, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME,
+     {{VK_KHR_MAINTENANCE_3_EXTENSION_NAME, VK_API_VERSION_1_1}},
+     VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT, sizeof(VkPhysicalDeviceDescriptorIndexingFeaturesEXT),
+     {offsetof(VkPhysicalDeviceDescriptorIndexingFeaturesEXT, shaderSampledImageArrayNonUniformIndexing),
+      offsetof(VkPhysicalDeviceDescriptorIndexingFeaturesEXT, descriptorBindingPartiallyBound),
+      offsetof(VkPhysicalDeviceDescriptorIndexingFeaturesEXT, descriptorBindingVariableDescriptorCount),
+      offsetof(VkPhysicalDeviceDescriptorIndexingFeaturesEXT, runtimeDescriptorArray)}},
+    // Before 1.1 it needs VK_KHR_device_group, which in turn needs VK_KHR_device_group_creation on the instance. Not worth it for 1.0 drivers
+    {"buffer_device_address", &OptionalFeatures::bufferDeviceAddress, VK_API_VERSION_1_2, VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME,
+     {{nullptr, VK_API_VERSION_1_1}},
+     VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES_KHR, sizeof(VkPhysicalDeviceBufferDeviceAddressFeaturesKHR),
+     {offsetof(VkPhysicalDeviceBufferDeviceAddressFeaturesKHR, bufferDeviceAddress)}},
+};
+
+uint32_t negotiateApiVersion(uint32_t loaderVersion) {
+    // Patch versions don't matter for what we may use, and the loader's is whatever the SDK was
+    uint32_t version = VK_MAKE_API_VERSION(0, VK_API_VERSION_MAJOR(loaderVersion), VK_API_VERSION_MINOR(loaderVersion), 0);
+    return std::min(version, newestApiVersion);
+}
+
+std::string formatApiVersion(uint32_t version) {
+    return std::to_string(VK_API_VERSION_MAJOR(version)) + "." + std::to_string(VK_API_VERSION_MINOR(version)) + "." + std::to_string(VK_API_VERSION_PATCH(version));
+}
+
+static bool containsExtension(const std::vector<VkExtensionProperties>& extensions, const char* name) {
+    for (const auto& extension : extensions) {
+        if (strcmp(extension.extensionName, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Whether the feature can be had at apiVersion with these device extensions. If so, adds the extensions that have to be enabled for it
+static bool collectExtensions(const OptionalFeature& feature, uint32_t apiVersion, const std::vector<VkExtensionProperties>& available,
+                              std::vector<const char*>& extensions) {
+    if (apiVersion >= feature.coreVersion) return true;
+    if (!containsExtension(available, feature.extension)) return false;
+
+    std::vector<const char*> needed = {feature.extension};
+    for (const ExtensionDependency& dependency : feature.dependencies) {
+        if (apiVersion >= dependency.coreVersion) continue;
+        if (dependency.name == nullptr || !containsExtension(available, dependency.name)) return false;
+        needed.push_back(dependency.name);
+    }
+    for (const char* name : needed) {
+        bool listed = std::any_of(extensions.begin(), extensions.end(), [name](const char* other) { return strcmp(name, other) == 0; });
+        if (!listed) {
+            extensions.push_back(name); // two features may share a dependency
+        }
+    }
+    return true;
+}
+
+// A zeroed feature struct with its sType set, linked in front of next
+static VkBaseOutStructure* makeFeatureStruct(const OptionalFeature& feature, std::vector<uint64_t>& storage, void* next) {
+    storage.assign((feature.structureSize + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+    VkBaseOutStructure* header = reinterpret_cast<VkBaseOutStructure*>(storage.data());
+    header->sType = feature.structureType;
+    header->pNext = static_cast<VkBaseOutStructure*>(next);
+    return header;
+}
+
+static VkBool32& featureMember(std::vector<uint64_t>& storage, size_t offset) {
+    return *reinterpret_cast<VkBool32*>(reinterpret_cast<char*>(storage.data()) + offset);
+}
+
+OptionalFeatures queryOptionalFeatures(PFN_vkGetPhysicalDeviceFeatures2KHR getFeatures2, VkPhysicalDevice device, uint32_t apiVersion,
+                                       const std::vector<VkExtensionProperties>& extensions) {
+    OptionalFeatures features;
+    features.apiVersion = apiVersion;
+    if (getFeatures2 == nullptr) return features;
+
+    // Only structs for features the device could have may go in the chain, the others are invalid usage
+    std::vector<std::vector<uint64_t>> structs(optionalFeatureTable.size());
+    void* next = nullptr;
+    for (size_t i = 0; i < optionalFeatureTable.size(); i++) {
+        std::vector<const char*> unused;
+        if (collectExtensions(optionalFeatureTable[i], apiVersion, extensions, unused)) {
+            next = makeFeatureStruct(optionalFeatureTable[i], structs[i], next);
+        }
+    }
+    if (next == nullptr) return features;
+
+    VkPhysicalDeviceFeatures2KHR features2 = {};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+    features2.pNext = next;
+    getFeatures2(device, &features2);
+
+    for (size_t i = 0; i < optionalFeatureTable.size(); i++) {
+        const OptionalFeature& feature = optionalFeatureTable[i];
+        if (structs[i].empty()) continue;
+        features.*feature.flag = std::all_of(feature.members.begin(), feature.members.end(),
+                                             [&](size_t offset) { return featureMember(structs[i], offset) == VK_TRUE; });
+    }
+    return features;
+}
+
+void printOptionalFeatures(const OptionalFeatures& features) {
+    std::cout << "API version " << formatApiVersion(features.apiVersion) << ". Optional features:";
+    for (const OptionalFeature& feature : optionalFeatureTable) {
+        std::cout << " " << feature.name << (features.*feature.flag ? "=yes" : "=no");
+    }
+    std::cout << std::endl;
+}
+
+FeatureChain::FeatureChain(const DeviceCapabilities& capabilities) {
+    const OptionalFeatures& features = capabilities.optionalFeatures;
+    structs.resize(optionalFeatureTable.size());
+    for (size_t i = 0; i < optionalFeatureTable.size(); i++) {
+        const OptionalFeature& feature = optionalFeatureTable[i];
+        if (!(features.*feature.flag)) continue;
+        collectExtensions(feature, features.apiVersion, capabilities.extensions, enabledExtensions);
+        makeFeatureStruct(feature, structs[i], nullptr);
+        for (size_t offset : feature.members) {
+            featureMember(structs[i], offset) = VK_TRUE; // just what we asked about: the rest of the struct may cost something and we don't use it
+        }
+    }
+}
+
+void* FeatureChain::chain(void* next) {
+    for (std::vector<uint64_t>& storage : structs) {
+        if (storage.empty()) continue;
+        reinterpret_cast<VkBaseOutStructure*>(storage.data())->pNext = static_cast<VkBaseOutStructure*>(next);
+        next = storage.data();
+    }
+    return next;
+}
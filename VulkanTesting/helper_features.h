@@ -0,0 +1,61 @@
+//
+//  helper_features.h
+//  VulkanTesting
+//
+//  Optional Vulkan versions, extensions and features: what we ask for, and what the device ends up with.
+//
+
+#ifndef helper_features_h
+#define helper_features_h
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct DeviceCapabilities;
+
+// The newest version we know how to use
+const uint32_t newestApiVersion = VK_API_VERSION_1_3;
+
+// The API version to create the instance with: the loader's, capped at newestApiVersion. A 1.0 loader fails instance creation
+// for anything higher, 1.1 and later ones accept anything and devices then give us min(that, their own version)
+uint32_t negotiateApiVersion(uint32_t loaderVersion);
+std::string formatApiVersion(uint32_t version);
+
+// What the device can do on top of plain Vulkan 1.0, and createLogicalDevice switches on. Code with a faster path branches on these
+// rather than checking versions and extensions itself: a flag is true whichever way the feature got there, as core in apiVersion
+// or through its extension
+struct OptionalFeatures {
+    uint32_t apiVersion = VK_API_VERSION_1_0; // usable on this device: the lower of the instance's and the device's
+    bool timelineSemaphore = false;   // vkWaitSemaphores and counting semaphores. Required, our frame scheduling is built on it
+    bool synchronization2 = false;    // vkCmdPipelineBarrier2 and vkQueueSubmit2, with stages and accesses in one place
+    bool dynamicRendering = false;    // vkCmdBeginRendering, no render pass or framebuffer objects
+    bool descriptorIndexing = false;  // bindless: runtime sized, partially bound descriptor arrays, indexed non-uniformly
+    bool bufferDeviceAddress = false; // GPU pointers to buffers
+};
+
+// Asks the device about every feature in the table (in helper_features.cpp). getFeatures2 comes from VK_KHR_get_physical_device_properties2,
+// extensions is what the device has
+OptionalFeatures queryOptionalFeatures(PFN_vkGetPhysicalDeviceFeatures2KHR getFeatures2, VkPhysicalDevice device, uint32_t apiVersion,
+                                       const std::vector<VkExtensionProperties>& extensions);
+void printOptionalFeatures(const OptionalFeatures& features);
+
+// What vkCreateDevice needs to switch on the device's optionalFeatures: the extensions that provide them (none for those that are core
+// in its apiVersion), and their feature structs chained through pNext. The structs live in here, so keep it around until the device exists
+class FeatureChain {
+    public:
+    explicit FeatureChain(const DeviceCapabilities& capabilities);
+    FeatureChain(const FeatureChain&) = delete;
+    FeatureChain& operator=(const FeatureChain&) = delete;
+
+    const std::vector<const char*>& extensions() const { return enabledExtensions; }
+    // Puts our structs in front of next, and returns the head of the chain for VkDeviceCreateInfo::pNext
+    void* chain(void* next);
+
+    private:
+    std::vector<const char*> enabledExtensions;
+    std::vector<std::vector<uint64_t>> structs; // uint64_t only to get the alignment right, they're all sType, pNext and VkBool32s
+};
+
+#endif /* helper_features_h */
@@ -0,0 +1,79 @@
+//
+//  helper_frame_limiter.cpp
+//  VulkanTesting
+//
+//  Caps the frame rate without relying on vsync.
+//
+#include "helper_frame_limiter.h"
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+FrameLimiter::FrameLimiter(double targetFrameSeconds)
+    : target(targetFrameSeconds > 0 ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(targetFrameSeconds)) : Clock::duration::zero()) {
+}
+
+void FrameLimiter::wait() {
+    if (!enabled()) return;
+
+    Clock::time_point now = Clock::now();
+    if (!started) {
+        started = true;
+        lastFrameStart = now;
+        deadline = now + target;
+        return;
+    }
+
+    bool late = now >= deadline;
+    if (!late) {
+        // Coarse part: sleep, but wake up early enough to absorb the typical oversleep
+        Clock::duration margin = sleepMargin();
+        if (deadline - now > margin) {
+            Clock::time_point wakeTime = deadline - margin;
+            std::this_thread::sleep_until(wakeTime);
+            // Calibrate: exponential moving average of how late the OS woke us up
+            std::chrono::duration<double> overshoot = Clock::now() - wakeTime;
+            sleepOvershootSeconds = 0.9 * sleepOvershootSeconds + 0.1 * std::max(overshoot.count(), 0.0);
+        }
+
+        // Fine part: spin the last stretch
+        while (Clock::now() < deadline) {
+            std::this_thread::yield();
+        }
+        now = Clock::now();
+        wakeErrors.add(std::chrono::duration<double, std::milli>(now - deadline).count());
+    } else {
+        missedDeadlines++;
+    }
+
+    intervals.add(std::chrono::duration<double, std::milli>(now - lastFrameStart).count());
+    lastFrameStart = now;
+
+    // Keep a steady cadence measured from the deadlines, not from when we happened to wake up.
+    // If we fell more than a frame behind, start over from now rather than rendering a burst of frames to catch up
+    deadline += target;
+    if (deadline < now) {
+        deadline = now + target;
+    }
+}
+
+FrameLimiter::Clock::time_point FrameLimiter::sleepDeadline() const {
+    if (!enabled() || !started) return Clock::time_point();
+    return deadline - sleepMargin();
+}
+
+FrameLimiter::Clock::duration FrameLimiter::sleepMargin() const {
+    return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(2.0 * sleepOvershootSeconds + 0.0001));
+}
+
+void FrameLimiter::printReport() const {
+    if (!enabled() || intervals.empty()) return;
+    std::cout << "Frame limiter: target " << std::chrono::duration<double, std::milli>(target).count() << " ms"
+              << ", last " << intervals.count() << " intervals avg=" << intervals.mean() << " ms"
+              << " jitter(stddev)=" << intervals.stddev() << " ms"
+              << " p99=" << intervals.percentile(99) << " ms"
+              << ", wake error p50=" << wakeErrors.percentile(50) << " ms"
+              << " p99=" << wakeErrors.percentile(99) << " ms"
+              << ", missed deadlines: " << missedDeadlines
+              << ", calibrated sleep overshoot " << sleepOvershootSeconds * 1000.0 << " ms" << std::endl;
+}
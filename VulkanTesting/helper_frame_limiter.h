@@ -0,0 +1,54 @@
+//
+//  helper_frame_limiter.h
+//  VulkanTesting
+//
+//  Caps the frame rate without relying on vsync.
+//
+
+#ifndef helper_frame_limiter_h
+#define helper_frame_limiter_h
+#include <chrono>
+#include <cstdint>
+#include "helper_stats.h"
+
+// OS sleeps are cheap but coarse: they routinely wake up a millisecond or more late. Spinning is exact but burns a core.
+// So we sleep until shortly before the deadline and spin the rest. How early we wake up is calibrated from how late the sleeps
+// have actually been on this machine, so the spin stays short
+class FrameLimiter {
+    public:
+    typedef std::chrono::steady_clock Clock;
+
+    // targetFrameSeconds <= 0 disables the limiter
+    explicit FrameLimiter(double targetFrameSeconds);
+
+    bool enabled() const { return target.count() > 0; }
+    // Blocks until it's time to start the next frame. Call once per frame, before sampling input
+    void wait();
+    // Until when wait() will sleep rather than spin, so the caller can spend that time waiting on something else first.
+    // In the past when disabled or behind
+    Clock::time_point sleepDeadline() const;
+    void printReport() const;
+
+    // Jitter statistics, all in milliseconds
+    const SampleStats& frameIntervals() const { return intervals; }
+    const SampleStats& wakeErrorStats() const { return wakeErrors; }
+    uint64_t missedDeadlineCount() const { return missedDeadlines; }
+
+    private:
+    Clock::duration target;
+    Clock::time_point deadline; // when the next frame should start
+    Clock::time_point lastFrameStart;
+    bool started = false;
+    double sleepOvershootSeconds = 0.001; // running estimate of how late a sleep returns, starts pessimistic
+
+    // How early to stop sleeping to absorb the typical oversleep (with some headroom)
+    Clock::duration sleepMargin() const;
+
+    // The limiter runs for the lifetime of the window, so the jitter is over a recent window of frames rather than all of them
+    static const size_t jitterWindow = 4096;
+    SampleStats intervals{jitterWindow}; // ms between consecutive frame starts
+    SampleStats wakeErrors{jitterWindow}; // ms we started a frame after its deadline, only for frames we actually waited for
+    uint64_t missedDeadlines = 0; // frames that were already late before we could wait
+};
+
+#endif /* helper_frame_limiter_h */
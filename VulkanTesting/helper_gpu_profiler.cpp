@@ -0,0 +1,216 @@
+//
+//  helper_gpu_profiler.cpp
+//  VulkanTesting
+//
+//  GPU timings and pipeline statistics for named scopes, from queries the command buffers write themselves.
+//
+#include "helper_gpu_profiler.h"
+#include <iostream>
+#include <stdexcept>
+
+// Results come back in bit order, so this is also the order of the three values a query returns
+static const VkQueryPipelineStatisticFlags pipelineStatisticFlags =
+    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+static const uint32_t pipelineStatisticCount = 3;
+
+void GpuProfiler::init(VkDevice device, double timestampPeriod, uint32_t timestampValidBits, bool pipelineStatistics, const DeviceDispatch& dispatch,
+                       const VkAllocationCallbacks* allocator) {
+    this->device = device;
+    this->dispatch = &dispatch;
+    this->allocator = allocator;
+    statisticsEnabled = pipelineStatistics;
+
+    // Ticks are converted to time with the device's timestamp period. Only the low timestampValidBits of a timestamp mean anything
+    nanosecondsPerTick = timestampPeriod;
+    timestampMask = timestampValidBits >= 64 ? ~0ull : (1ull << timestampValidBits) - 1;
+}
+
+GpuProfiler::ScopeId GpuProfiler::addScope(const std::string& name, bool statistics) {
+    if (slotCount > 0) {
+        throw std::runtime_error("GPU profiler scopes must be added before the query pools are created");
+    }
+    Scope scope;
+    scope.name = name;
+    scope.statistics = statistics;
+    if (statistics) {
+        scope.statisticsQuery = statisticsScopeCount++;
+    }
+    scopes.push_back(scope);
+    return static_cast<ScopeId>(scopes.size() - 1);
+}
+
+void GpuProfiler::createPools(uint32_t slotCount) {
+    if (!enabled() || scopes.empty()) return;
+
+    this->slotCount = slotCount;
+    pendingFrames.assign(slotCount, 0);
+    // No more scopes can be added from here on
+    timestamps.assign(timestampMask != 0 ? scopes.size() * 2 : 0, 0);
+    counters.assign(statisticsEnabled ? statisticsScopeCount * pipelineStatisticCount : 0, 0);
+
+    if (timestampMask != 0) {
+        VkQueryPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        poolInfo.queryCount = static_cast<uint32_t>(scopes.size() * 2);
+
+        timestampPools.resize(slotCount);
+        for (uint32_t i = 0; i < slotCount; i++) {
+            if (vkCreateQueryPool(device, &poolInfo, allocator, &timestampPools[i]) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create timestamp query pool");
+            }
+        }
+    }
+
+    if (statisticsEnabled && statisticsScopeCount > 0) {
+        VkQueryPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+        poolInfo.queryCount = statisticsScopeCount;
+        poolInfo.pipelineStatistics = pipelineStatisticFlags;
+
+        statisticsPools.resize(slotCount);
+        for (uint32_t i = 0; i < slotCount; i++) {
+            if (vkCreateQueryPool(device, &poolInfo, allocator, &statisticsPools[i]) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create pipeline statistics query pool");
+            }
+        }
+    }
+}
+
+std::vector<VkQueryPool> GpuProfiler::releasePools() {
+    std::vector<VkQueryPool> released;
+    released.swap(timestampPools);
+    released.insert(released.end(), statisticsPools.begin(), statisticsPools.end());
+    statisticsPools.clear();
+    slotCount = 0;
+    pendingFrames.clear(); // whatever they held is lost, those frames just won't be counted
+    return released;
+}
+
+void GpuProfiler::destroyPools(const std::vector<VkQueryPool>& pools) {
+    for (VkQueryPool pool : pools) {
+        vkDestroyQueryPool(device, pool, allocator);
+    }
+}
+
+void GpuProfiler::destroy() {
+    destroyPools(releasePools());
+}
+
+void GpuProfiler::reset(VkCommandBuffer commandBuffer, uint32_t slot) {
+    // Queries have to be reset before they're written again, and doing it in the command buffer keeps it in order with the writes
+    if (slot < timestampPools.size()) {
+        dispatch->vkCmdResetQueryPool(commandBuffer, timestampPools[slot], 0, static_cast<uint32_t>(scopes.size() * 2));
+    }
+    if (slot < statisticsPools.size()) {
+        dispatch->vkCmdResetQueryPool(commandBuffer, statisticsPools[slot], 0, statisticsScopeCount);
+    }
+}
+
+void GpuProfiler::begin(VkCommandBuffer commandBuffer, uint32_t slot, ScopeId scope) {
+    if (slot < timestampPools.size()) {
+        // Top of pipe: as soon as the commands after this one start
+        dispatch->vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPools[slot], scope * 2);
+    }
+    if (scopes[scope].statistics && slot < statisticsPools.size()) {
+        dispatch->vkCmdBeginQuery(commandBuffer, statisticsPools[slot], scopes[scope].statisticsQuery, 0);
+    }
+}
+
+void GpuProfiler::end(VkCommandBuffer commandBuffer, uint32_t slot, ScopeId scope) {
+    // Reverse order of begin(), so the timestamps include the whole query
+    if (scopes[scope].statistics && slot < statisticsPools.size()) {
+        dispatch->vkCmdEndQuery(commandBuffer, statisticsPools[slot], scopes[scope].statisticsQuery);
+    }
+    if (slot < timestampPools.size()) {
+        // Bottom of pipe: once everything before this has completely finished
+        dispatch->vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPools[slot], scope * 2 + 1);
+    }
+}
+
+GpuProfiler::Zone::Zone(GpuProfiler& profiler, VkCommandBuffer commandBuffer, uint32_t slot, ScopeId scope)
+    : profiler(profiler), commandBuffer(commandBuffer), slot(slot), scope(scope) {
+    profiler.begin(commandBuffer, slot, scope);
+}
+
+GpuProfiler::Zone::~Zone() {
+    profiler.end(commandBuffer, slot, scope);
+}
+
+void GpuProfiler::submitted(uint32_t slot, uint64_t frame) {
+    if (slot < pendingFrames.size()) {
+        pendingFrames[slot] = frame;
+    }
+}
+
+bool GpuProfiler::collect(uint32_t slot) {
+    if (slot >= slotCount || pendingFrames[slot] == 0) return false;
+    uint64_t frame = pendingFrames[slot];
+    pendingFrames[slot] = 0;
+
+    // No WAIT flag: the frame is known to be complete, so the results are there. If a driver disagrees, skip the frame rather than stall
+    if (!timestampPools.empty()) {
+        VkResult result = dispatch->vkGetQueryPoolResults(device, timestampPools[slot], 0, static_cast<uint32_t>(timestamps.size()),
+                                                timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+        if (result != VK_SUCCESS) {
+            return false;
+        }
+    }
+    if (!statisticsPools.empty()) {
+        VkResult result = dispatch->vkGetQueryPoolResults(device, statisticsPools[slot], 0, statisticsScopeCount,
+                                                counters.size() * sizeof(uint64_t), counters.data(), pipelineStatisticCount * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+        if (result != VK_SUCCESS) {
+            return false;
+        }
+    }
+
+    frameCounters = PipelineCounters();
+    for (size_t i = 0; i < scopes.size(); i++) {
+        Scope& scope = scopes[i];
+        if (!timestampPools.empty()) {
+            uint64_t ticks = (timestamps[i * 2 + 1] - timestamps[i * 2]) & timestampMask; // the mask also takes care of a counter wrapping around
+            scope.lastMilliseconds = ticks * nanosecondsPerTick / 1000000.0;
+            scope.milliseconds.add(scope.lastMilliseconds);
+        }
+        if (scope.statistics && !statisticsPools.empty()) {
+            const uint64_t* values = &counters[scope.statisticsQuery * pipelineStatisticCount];
+            scope.lastCounters.vertexInvocations = values[0];
+            scope.lastCounters.clippingPrimitives = values[1];
+            scope.lastCounters.fragmentInvocations = values[2];
+            scope.vertexInvocations.add(static_cast<double>(values[0]));
+            scope.clippingPrimitives.add(static_cast<double>(values[1]));
+            scope.fragmentInvocations.add(static_cast<double>(values[2]));
+            frameCounters.vertexInvocations += values[0];
+            frameCounters.clippingPrimitives += values[1];
+            frameCounters.fragmentInvocations += values[2];
+        }
+    }
+    if (!statisticsPools.empty()) {
+        frameFragmentInvocations.add(static_cast<double>(frameCounters.fragmentInvocations));
+    }
+    lastCollectedFrame = frame;
+    return true;
+}
+
+void GpuProfiler::printReport() const {
+    for (const Scope& scope : scopes) {
+        if (!scope.milliseconds.empty()) {
+            std::cout << "GPU " << scope.name << ": avg=" << scope.milliseconds.mean() << " ms"
+                      << " p50=" << scope.milliseconds.percentile(50)
+                      << " p99=" << scope.milliseconds.percentile(99)
+                      << " max=" << scope.milliseconds.max() << " ms (" << scope.milliseconds.count() << " frames)" << std::endl;
+        }
+        if (!scope.fragmentInvocations.empty()) {
+            std::cout << "GPU " << scope.name << " per frame: vertex invocations avg=" << scope.vertexInvocations.mean()
+                      << ", clipping primitives avg=" << scope.clippingPrimitives.mean()
+                      << ", fragment invocations avg=" << scope.fragmentInvocations.mean()
+                      << " max=" << scope.fragmentInvocations.max() << std::endl;
+        }
+    }
+    if (!frameFragmentInvocations.empty()) {
+        std::cout << "GPU frame: fragment invocations avg=" << frameFragmentInvocations.mean() << " max=" << frameFragmentInvocations.max() << std::endl;
+    }
+}
@@ -0,0 +1,124 @@
+//
+//  helper_gpu_profiler.h
+//  VulkanTesting
+//
+//  GPU timings and pipeline statistics for named scopes, from queries the command buffers write themselves.
+//
+
+#ifndef helper_gpu_profiler_h
+#define helper_gpu_profiler_h
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "helper_stats.h"
+#include "helper_dispatch.h"
+
+// Counters from a pipeline statistics query. Overdraw shows up as fragment invocations growing faster than the pixels on screen,
+// and culling going wrong as clipping primitives growing while the scene doesn't
+struct PipelineCounters {
+    uint64_t vertexInvocations = 0;
+    uint64_t clippingPrimitives = 0; // primitives that made it out of clipping, i.e. were actually rasterized
+    uint64_t fragmentInvocations = 0;
+};
+
+// Our command buffers are recorded once and replayed, one per swapchain image. So instead of a ring indexed by frame,
+// every command buffer ("slot") gets query pools of its own, reset at the start of the command buffer itself.
+// A slot's results are read just before the slot is reused: by then the frame that wrote them has finished, so
+// vkGetQueryPoolResults never has to wait, and the CPU never stalls on the GPU to get timings
+class GpuProfiler {
+    public:
+    typedef uint32_t ScopeId;
+
+    // timestampPeriod comes from the device limits and timestampValidBits from the queue family we submit to; 0 valid bits skips timestamps.
+    // Pipeline statistics need the pipelineStatisticsQuery feature enabled on the device
+    // Query commands are recorded and results read through dispatch, which has to outlive the profiler.
+    // The query pools are created and destroyed with allocator, which may be nullptr
+    void init(VkDevice device, double timestampPeriod, uint32_t timestampValidBits, bool pipelineStatistics, const DeviceDispatch& dispatch,
+              const VkAllocationCallbacks* allocator = nullptr);
+    bool enabled() const { return timestampMask != 0 || statisticsEnabled; }
+    bool hasStatistics() const { return statisticsEnabled; }
+    // Scopes have to be known before the pools are created, every slot records the same ones.
+    // With statistics, the scope also counts pipeline statistics. Only one of those can be active at a time, so such scopes must not nest
+    ScopeId addScope(const std::string& name, bool statistics = false);
+
+    // Pools for slotCount command buffers. When recreating, releasePools() first: the old command buffers may still be executing,
+    // so the old pools have to live as long as they do
+    void createPools(uint32_t slotCount);
+    std::vector<VkQueryPool> releasePools();
+    void destroyPools(const std::vector<VkQueryPool>& pools);
+    void destroy();
+
+    // Recording. reset() must come before any scope in the command buffer, and outside a render pass.
+    // A scope has to begin and end on the same side of a render pass boundary
+    void reset(VkCommandBuffer commandBuffer, uint32_t slot);
+    void begin(VkCommandBuffer commandBuffer, uint32_t slot, ScopeId scope);
+    void end(VkCommandBuffer commandBuffer, uint32_t slot, ScopeId scope);
+
+    // begin() in the constructor, end() in the destructor
+    class Zone {
+        public:
+        Zone(GpuProfiler& profiler, VkCommandBuffer commandBuffer, uint32_t slot, ScopeId scope);
+        ~Zone();
+        Zone(const Zone&) = delete;
+        Zone& operator=(const Zone&) = delete;
+
+        private:
+        GpuProfiler& profiler;
+        VkCommandBuffer commandBuffer;
+        uint32_t slot;
+        ScopeId scope;
+    };
+
+    // The slot's command buffer was submitted as the given frame
+    void submitted(uint32_t slot, uint64_t frame);
+    // Reads the slot's results. Only call once the frame it was last submitted with has completed. Returns false if there was nothing new
+    bool collect(uint32_t slot);
+
+    // Results of the last successful collect()
+    uint64_t lastFrame() const { return lastCollectedFrame; }
+    bool hasTimings() const { return timestampMask != 0; }
+    double lastMilliseconds(ScopeId scope) const { return scopes[scope].lastMilliseconds; }
+    bool hasCounters(ScopeId scope) const { return statisticsEnabled && scopes[scope].statistics; }
+    const PipelineCounters& lastCounters(ScopeId scope) const { return scopes[scope].lastCounters; }
+    const PipelineCounters& lastFrameCounters() const { return frameCounters; } // all statistics scopes added up
+    // Summaries over the last historyFrames collected frames: the profiler runs for as long as the window is open
+    static const size_t historyFrames = 4096;
+    size_t scopeCount() const { return scopes.size(); }
+    const std::string& scopeName(ScopeId scope) const { return scopes[scope].name; }
+    const SampleStats& stats(ScopeId scope) const { return scopes[scope].milliseconds; }
+    void printReport() const;
+
+    private:
+    struct Scope {
+        std::string name;
+        bool statistics = false;
+        uint32_t statisticsQuery = 0; // index in the statistics pools
+        double lastMilliseconds = 0.0;
+        SampleStats milliseconds{historyFrames};
+        PipelineCounters lastCounters;
+        SampleStats vertexInvocations{historyFrames}, clippingPrimitives{historyFrames}, fragmentInvocations{historyFrames};
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    const DeviceDispatch* dispatch = nullptr;
+    const VkAllocationCallbacks* allocator = nullptr;
+    double nanosecondsPerTick = 0.0;
+    uint64_t timestampMask = 0; // only the valid bits of a timestamp, 0 if timestamps aren't supported
+    bool statisticsEnabled = false;
+    uint32_t statisticsScopeCount = 0;
+    std::vector<Scope> scopes;
+    uint32_t slotCount = 0;
+    std::vector<VkQueryPool> timestampPools; // one per slot, two queries (begin, end) per scope
+    std::vector<VkQueryPool> statisticsPools; // one per slot, one query per statistics scope
+    std::vector<uint64_t> pendingFrames; // per slot, frame whose results haven't been read yet (0 = none)
+    // Where collect() reads the query results to, sized once the scopes are final so collecting a frame doesn't allocate
+    std::vector<uint64_t> timestamps; // two per scope
+    std::vector<uint64_t> counters; // pipelineStatisticCount per statistics scope
+    uint64_t lastCollectedFrame = 0;
+    PipelineCounters frameCounters;
+    SampleStats frameFragmentInvocations{historyFrames};
+};
+
+#endif /* helper_gpu_profiler_h */
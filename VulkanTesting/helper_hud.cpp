@@ -0,0 +1,304 @@
+//
+//  helper_hud.cpp
+//  VulkanTesting
+//
+//  Performance overlay: frame time graph, FPS, GPU time and memory, drawn on top of the frame with a 5x7 bitmap font.
+//
+#include "helper_hud.h"
+#include <cstddef>
+#include <cstdio>
+#include <stdexcept>
+
+// 5x7 font, one byte per row from the top, bit 4 is the leftmost column. Only what the overlay prints: digits, capitals and a bit of punctuation
+struct Glyph {
+    char character;
+    uint8_t rows[7];
+};
+
+static const Glyph glyphs[] = {
+    {'0', {0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E}},
+    {'1', {0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E}},
+    {'2', {0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F}},
+    {'3', {0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E}},
+    {'4', {0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02}},
+    {'5', {0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E}},
+    {'6', {0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E}},
+    {'7', {0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}},
+    {'8', {0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E}},
+    {'9', {0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C}},
+    {'A', {0x0E, 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11}},
+    {'B', {0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E}},
+    {'C', {0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E}},
+    {'D', {0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C}},
+    {'E', {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F}},
+    {'F', {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10}},
+    {'G', {0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F}},
+    {'H', {0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}},
+    {'I', {0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E}},
+    {'J', {0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C}},
+    {'K', {0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11}},
+    {'L', {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F}},
+    {'M', {0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11}},
+    {'N', {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11}},
+    {'O', {0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}},
+    {'P', {0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10}},
+    {'Q', {0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D}},
+    {'R', {0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11}},
+    {'S', {0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E}},
+    {'T', {0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}},
+    {'U', {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}},
+    {'V', {0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04}},
+    {'W', {0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A}},
+    {'X', {0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11}},
+    {'Y', {0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04}},
+    {'Z', {0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F}},
+    {'.', {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C}},
+    {'/', {0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00}},
+    {':', {0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00}},
+    {'%', {0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03}},
+    {'-', {0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00}},
+};
+
+static const Glyph* findGlyph(char character) {
+    if (character >= 'a' && character <= 'z') {
+        character = static_cast<char>(character - 'a' + 'A');
+    }
+    for (const Glyph& glyph : glyphs) {
+        if (glyph.character == character) {
+            return &glyph;
+        }
+    }
+    return nullptr; // spaces and anything we don't have are left blank
+}
+
+// Layout, in pixels
+static const float fontScale = 2.0f;               // screen pixels per font pixel
+static const float glyphAdvance = 6.0f * fontScale; // 5 columns and a gap
+static const float lineHeight = 9.0f * fontScale;   // 7 rows and a gap
+static const float margin = 8.0f;
+static const float padding = 6.0f;
+static const float graphHeight = 50.0f;
+static const float graphBarWidth = 2.0f;
+static const double graphMaxMilliseconds = 1000.0 / 30.0; // bars are clamped here
+static const double frameBudgetMilliseconds = 1000.0 / 60.0;
+
+static uint32_t rgba(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    return static_cast<uint32_t>(r) | (static_cast<uint32_t>(g) << 8) | (static_cast<uint32_t>(b) << 16) | (static_cast<uint32_t>(a) << 24);
+}
+
+VkVertexInputBindingDescription HudOverlay::bindingDescription() {
+    VkVertexInputBindingDescription binding = {};
+    binding.binding = 0;
+    binding.stride = sizeof(HudVertex);
+    binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    return binding;
+}
+
+std::array<VkVertexInputAttributeDescription, 2> HudOverlay::attributeDescriptions() {
+    std::array<VkVertexInputAttributeDescription, 2> attributes = {};
+    attributes[0].location = 0;
+    attributes[0].binding = 0;
+    attributes[0].format = VK_FORMAT_R32G32_SFLOAT;
+    attributes[0].offset = offsetof(HudVertex, x);
+    attributes[1].location = 1;
+    attributes[1].binding = 0;
+    attributes[1].format = VK_FORMAT_R8G8B8A8_UNORM; // arrives in the shader as a vec4 in 0..1
+    attributes[1].offset = offsetof(HudVertex, color);
+    return attributes;
+}
+
+void HudOverlay::init(VkDevice device, const DeviceDispatch& dispatch, const VkPhysicalDeviceMemoryProperties& memoryProperties,
+                      const HostAllocationTracker& allocations, bool visible) {
+    this->device = device;
+    this->dispatch = &dispatch;
+    this->memoryProperties = memoryProperties;
+    this->allocations = &allocations;
+    shown = visible;
+    // The draw command goes first in each slot, the vertices after it. Keeping slots 256-byte aligned is plenty for both
+    slotStride = (sizeof(VkDrawIndirectCommand) + sizeof(HudVertex) * maxVertices + 255) & ~static_cast<VkDeviceSize>(255);
+}
+
+void HudOverlay::createBuffers(uint32_t slotCount) {
+    this->slotCount = slotCount;
+
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = slotStride * slotCount;
+    bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(device, &bufferInfo, allocations->callbacks(HostAllocationObject::Buffer), &buffers.buffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create HUD buffer");
+    }
+
+    // Host visible so the CPU can write it directly, coherent so there's nothing to flush. On discrete GPUs the vertices are read
+    // over the bus, which for a few hundred KB per frame at most doesn't matter
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(device, buffers.buffer, &requirements);
+    VkMemoryPropertyFlags wanted = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    uint32_t memoryType = UINT32_MAX;
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        if ((requirements.memoryTypeBits & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & wanted) == wanted) {
+            memoryType = i;
+            break;
+        }
+    }
+    if (memoryType == UINT32_MAX) {
+        throw std::runtime_error("Failed to find host visible memory for the HUD");
+    }
+
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = requirements.size;
+    allocInfo.memoryTypeIndex = memoryType;
+    if (vkAllocateMemory(device, &allocInfo, allocations->callbacks(HostAllocationObject::Memory), &buffers.memory) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate HUD memory");
+    }
+    vkBindBufferMemory(device, buffers.buffer, buffers.memory, 0);
+
+    void* data;
+    if (vkMapMemory(device, buffers.memory, 0, VK_WHOLE_SIZE, 0, &data) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to map HUD memory");
+    }
+    mapped = static_cast<char*>(data);
+
+    // Until a slot's first update, draw nothing
+    for (uint32_t slot = 0; slot < slotCount; slot++) {
+        VkDrawIndirectCommand* command = reinterpret_cast<VkDrawIndirectCommand*>(mapped + slot * slotStride);
+        *command = {0, 1, 0, 0};
+    }
+}
+
+HudOverlay::Buffers HudOverlay::releaseBuffers() {
+    Buffers released = buffers;
+    buffers = Buffers();
+    mapped = nullptr;
+    slotCount = 0;
+    return released;
+}
+
+void HudOverlay::destroyBuffers(const Buffers& buffers) {
+    if (buffers.buffer == VK_NULL_HANDLE) return;
+    vkDestroyBuffer(device, buffers.buffer, allocations->callbacks(HostAllocationObject::Buffer));
+    vkFreeMemory(device, buffers.memory, allocations->callbacks(HostAllocationObject::Memory)); // unmaps too
+}
+
+void HudOverlay::destroy() {
+    destroyBuffers(releaseBuffers());
+}
+
+void HudOverlay::record(VkCommandBuffer commandBuffer, uint32_t slot) const {
+    if (slot >= slotCount) return;
+    VkDeviceSize slotOffset = slot * slotStride;
+    VkDeviceSize vertexOffset = slotOffset + sizeof(VkDrawIndirectCommand);
+    dispatch->vkCmdBindVertexBuffers(commandBuffer, 0, 1, &buffers.buffer, &vertexOffset);
+    dispatch->vkCmdDrawIndirect(commandBuffer, buffers.buffer, slotOffset, 1, sizeof(VkDrawIndirectCommand));
+}
+
+void HudOverlay::addFrameTime(double milliseconds) {
+    frameTimes[nextFrameTime] = milliseconds;
+    nextFrameTime = (nextFrameTime + 1) % historySize;
+    if (frameTimeCount < historySize) {
+        frameTimeCount++;
+    }
+}
+
+void HudOverlay::addRect(Batch& batch, float x, float y, float width, float height, uint32_t color) {
+    if (batch.count + 6 > maxVertices) return;
+    // Pixels (origin top left, y down) to clip space, which in Vulkan also has y down
+    float left = x * batch.scaleX - 1.0f;
+    float top = y * batch.scaleY - 1.0f;
+    float right = (x + width) * batch.scaleX - 1.0f;
+    float bottom = (y + height) * batch.scaleY - 1.0f;
+    HudVertex* vertex = batch.vertices + batch.count;
+    vertex[0] = {left, top, color};
+    vertex[1] = {right, top, color};
+    vertex[2] = {right, bottom, color};
+    vertex[3] = {left, top, color};
+    vertex[4] = {right, bottom, color};
+    vertex[5] = {left, bottom, color};
+    batch.count += 6;
+}
+
+void HudOverlay::addText(Batch& batch, float x, float y, const char* text, uint32_t color) {
+    for (; *text != '\0'; text++, x += glyphAdvance) {
+        const Glyph* glyph = findGlyph(*text);
+        if (glyph == nullptr) continue;
+        for (int row = 0; row < 7; row++) {
+            // One quad per run of lit pixels in the row rather than one per pixel
+            uint8_t bits = glyph->rows[row];
+            int column = 0;
+            while (column < 5) {
+                if (!(bits & (0x10 >> column))) {
+                    column++;
+                    continue;
+                }
+                int start = column;
+                while (column < 5 && (bits & (0x10 >> column))) {
+                    column++;
+                }
+                addRect(batch, x + start * fontScale, y + row * fontScale, (column - start) * fontScale, fontScale, color);
+            }
+        }
+    }
+}
+
+void HudOverlay::addGraph(Batch& batch, float x, float y, float width, float height) const {
+    addRect(batch, x, y, width, height, rgba(255, 255, 255, 24));
+    // Oldest on the left. Green within a 60 Hz frame, yellow within 30 Hz, red beyond
+    size_t first = (nextFrameTime + historySize - frameTimeCount) % historySize;
+    for (size_t i = 0; i < frameTimeCount; i++) {
+        double milliseconds = frameTimes[(first + i) % historySize];
+        double clamped = milliseconds < graphMaxMilliseconds ? milliseconds : graphMaxMilliseconds;
+        float barHeight = static_cast<float>(clamped / graphMaxMilliseconds) * height;
+        uint32_t color = milliseconds <= frameBudgetMilliseconds ? rgba(80, 220, 80, 255)
+                       : milliseconds <= graphMaxMilliseconds ? rgba(230, 200, 60, 255)
+                       : rgba(230, 70, 60, 255);
+        addRect(batch, x + (historySize - frameTimeCount + i) * graphBarWidth, y + height - barHeight, graphBarWidth, barHeight, color);
+    }
+    float budgetY = y + height - static_cast<float>(frameBudgetMilliseconds / graphMaxMilliseconds) * height;
+    addRect(batch, x, budgetY, width, 1.0f, rgba(255, 255, 255, 96));
+}
+
+void HudOverlay::update(uint32_t slot, VkExtent2D extent, const HudStats& stats) {
+    if (slot >= slotCount) return;
+    VkDrawIndirectCommand* command = reinterpret_cast<VkDrawIndirectCommand*>(mapped + slot * slotStride);
+    if (!shown || extent.width == 0 || extent.height == 0) {
+        command->vertexCount = 0;
+        return;
+    }
+
+    Batch batch;
+    batch.vertices = reinterpret_cast<HudVertex*>(mapped + slot * slotStride + sizeof(VkDrawIndirectCommand));
+    batch.count = 0;
+    batch.scaleX = 2.0f / extent.width;
+    batch.scaleY = 2.0f / extent.height;
+
+    double averageMilliseconds = 0.0;
+    for (size_t i = 0; i < frameTimeCount; i++) {
+        averageMilliseconds += frameTimes[i];
+    }
+    averageMilliseconds = frameTimeCount > 0 ? averageMilliseconds / frameTimeCount : 0.0;
+
+    // snprintf into the stack, the vertices go straight into mapped memory: nothing here allocates
+    char lines[4][48];
+    int lineCount = 0;
+    std::snprintf(lines[lineCount++], sizeof(lines[0]), "FPS %.1f  FRAME %.2f MS", averageMilliseconds > 0.0 ? 1000.0 / averageMilliseconds : 0.0, averageMilliseconds);
+    std::snprintf(lines[lineCount++], sizeof(lines[0]), "CPU %.2f MS", stats.cpuMilliseconds);
+    if (stats.hasGpuTime) {
+        std::snprintf(lines[lineCount++], sizeof(lines[0]), "GPU %.3f MS  HUD %.3f MS", stats.gpuMilliseconds, stats.hudMilliseconds);
+    }
+    if (stats.hasMemory) {
+        std::snprintf(lines[lineCount++], sizeof(lines[0]), "VRAM %.0f/%.0f MIB", stats.memoryUsedMiB, stats.memoryBudgetMiB);
+    }
+
+    float graphWidth = historySize * graphBarWidth;
+    float panelHeight = padding * 2 + lineCount * lineHeight + graphHeight;
+    addRect(batch, margin, margin, graphWidth + padding * 2, panelHeight, rgba(0, 0, 0, 160));
+    float y = margin + padding;
+    for (int i = 0; i < lineCount; i++, y += lineHeight) {
+        addText(batch, margin + padding, y, lines[i], rgba(255, 255, 255, 255));
+    }
+    addGraph(batch, margin + padding, y, graphWidth, graphHeight);
+
+    command->vertexCount = batch.count;
+}
@@ -0,0 +1,99 @@
+//
+//  helper_hud.h
+//  VulkanTesting
+//
+//  Performance overlay: frame time graph, FPS, GPU time and memory, drawn on top of the frame with a 5x7 bitmap font.
+//
+
+#ifndef helper_hud_h
+#define helper_hud_h
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <array>
+#include <cstdint>
+#include "helper_allocator.h"
+#include "helper_dispatch.h"
+
+// Positions already in clip space, so the vertex shader has nothing to do. Color is RGBA8, red in the lowest byte
+struct HudVertex {
+    float x, y;
+    uint32_t color;
+};
+
+// What the overlay shows besides the frame times, filled in by the application every frame
+struct HudStats {
+    double cpuMilliseconds = 0.0; // CPU time of the last frame
+    bool hasGpuTime = false;
+    double gpuMilliseconds = 0.0; // the whole render pass
+    double hudMilliseconds = 0.0; // the overlay alone, so we can see it stays cheap
+    bool hasMemory = false;
+    double memoryUsedMiB = 0.0;
+    double memoryBudgetMiB = 0.0;
+};
+
+// Our command buffers are recorded once, so the overlay can't record different draws every frame. Instead each command buffer
+// ("slot") gets a region of a host-visible buffer holding a VkDrawIndirectCommand and the vertices, and the recorded vkCmdDrawIndirect
+// reads how many vertices to draw from there. Every frame the CPU rewrites its slot's region, once the GPU is done with it.
+// Hiding the overlay just writes a vertex count of 0, no re-recording needed.
+// There's no texture: every lit pixel run of the font becomes a quad. A few thousand vertices, all in one draw call
+class HudOverlay {
+    public:
+    struct Buffers {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+    };
+
+    // For the pipeline's vertex input state
+    static VkVertexInputBindingDescription bindingDescription();
+    static std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions();
+
+    // record() goes through dispatch, which has to outlive the overlay
+    void init(VkDevice device, const DeviceDispatch& dispatch, const VkPhysicalDeviceMemoryProperties& memoryProperties,
+              const HostAllocationTracker& allocations, bool visible);
+    // Same dance as the GPU profiler's query pools: when recreating, releaseBuffers() first and destroy what it returns once the
+    // command buffers that used it have finished
+    void createBuffers(uint32_t slotCount);
+    Buffers releaseBuffers();
+    void destroyBuffers(const Buffers& buffers);
+    void destroy();
+
+    // Inside the render pass, with the overlay pipeline bound
+    void record(VkCommandBuffer commandBuffer, uint32_t slot) const;
+
+    void toggle() { shown = !shown; }
+    bool visible() const { return shown; }
+    // Milliseconds between the starts of two frames, once per frame
+    void addFrameTime(double milliseconds);
+    // Rewrites the slot's vertices. Only call once the GPU is done with the slot's last frame
+    void update(uint32_t slot, VkExtent2D extent, const HudStats& stats);
+
+    private:
+    static const uint32_t maxVertices = 16384; // per slot. Anything past this is dropped rather than overflowing the buffer
+    static const size_t historySize = 120; // frames in the graph
+
+    VkDevice device = VK_NULL_HANDLE;
+    const DeviceDispatch* dispatch = nullptr;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    const HostAllocationTracker* allocations = nullptr;
+    bool shown = false;
+    Buffers buffers;
+    VkDeviceSize slotStride = 0;
+    uint32_t slotCount = 0;
+    char* mapped = nullptr; // persistently mapped, host coherent so writes need no flush
+
+    std::array<double, historySize> frameTimes = {};
+    size_t frameTimeCount = 0;
+    size_t nextFrameTime = 0;
+
+    // Building one slot's vertices
+    struct Batch {
+        HudVertex* vertices;
+        uint32_t count;
+        float scaleX, scaleY; // pixels to clip space
+    };
+    static void addRect(Batch& batch, float x, float y, float width, float height, uint32_t color);
+    static void addText(Batch& batch, float x, float y, const char* text, uint32_t color);
+    void addGraph(Batch& batch, float x, float y, float width, float height) const;
+};
+
+#endif /* helper_hud_h */
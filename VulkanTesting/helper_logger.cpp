@@ -0,0 +1,162 @@
+//
+//  helper_logger.cpp
+//  VulkanTesting
+//
+//  Validation layer messages, filtered and deduplicated on the calling thread and written out on a thread of our own.
+//
+#include "helper_logger.h"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+static const VkDebugUtilsMessageSeverityFlagsEXT allSeverities =
+    VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT |
+    VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT |
+    VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
+    VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+
+static const VkDebugUtilsMessageTypeFlagsEXT allTypes =
+    VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT |
+    VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
+    VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+
+VkDebugUtilsMessageSeverityFlagsEXT severitiesFrom(VkDebugUtilsMessageSeverityFlagBitsEXT minimum) {
+    // The severity bits go up with the severity, so "this one and above" is every bit from minimum's up
+    return allSeverities & ~(static_cast<VkDebugUtilsMessageSeverityFlagsEXT>(minimum) - 1);
+}
+
+static const char* severityName(VkDebugUtilsMessageSeverityFlagBitsEXT severity) {
+    switch (severity) {
+        case VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT: return "verbose";
+        case VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT: return "info";
+        case VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT: return "warning";
+        case VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT: return "error";
+        default: return "unknown";
+    }
+}
+
+ValidationLogger::ValidationLogger()
+    : queue(new MpscQueue<Entry, 256>()),
+      repeatCounters(new RepeatCounter[repeatTableSize]),
+      severityMask(allSeverities),
+      typeMask(allTypes) {
+}
+
+ValidationLogger::~ValidationLogger() {
+    stop();
+}
+
+void ValidationLogger::setFilter(VkDebugUtilsMessageSeverityFlagsEXT severities, VkDebugUtilsMessageTypeFlagsEXT types) {
+    severityMask.store(severities, std::memory_order_relaxed);
+    typeMask.store(types, std::memory_order_relaxed);
+}
+
+void ValidationLogger::start() {
+    if (running) return;
+    running = true;
+    writer = std::thread(&ValidationLogger::writeLoop, this);
+}
+
+void ValidationLogger::stop() {
+    if (!running) return;
+    running = false;
+    writer.join(); // the writer drains the queue once more on its way out
+    printSummary();
+}
+
+uint32_t ValidationLogger::countRepeat(int32_t messageId) {
+    uint64_t key = static_cast<uint32_t>(messageId) | (1ull << 32);
+    size_t index = (static_cast<uint32_t>(messageId) * 2654435761u) & (repeatTableSize - 1); // Knuth's multiplicative hash
+    for (size_t probe = 0; probe < repeatTableSize; probe++) {
+        RepeatCounter& counter = repeatCounters[(index + probe) & (repeatTableSize - 1)];
+        uint64_t existing = counter.key.load(std::memory_order_acquire);
+        if (existing == 0) {
+            // Empty: try to take it. If another thread beat us to it, existing now holds whatever key it wrote
+            if (counter.key.compare_exchange_strong(existing, key, std::memory_order_acq_rel)) {
+                existing = key;
+            }
+        }
+        if (existing == key) {
+            return counter.count.fetch_add(1, std::memory_order_relaxed) + 1;
+        }
+    }
+    return 0;
+}
+
+void ValidationLogger::log(VkDebugUtilsMessageSeverityFlagBitsEXT severity, VkDebugUtilsMessageTypeFlagsEXT type, const VkDebugUtilsMessengerCallbackDataEXT* data) {
+    if ((severity & severities()) == 0 || (type & types()) == 0) {
+        return;
+    }
+
+    // Id 0 is what the loader and some layers use for messages that have no id of their own, those are all different
+    bool lastOne = false;
+    uint32_t limit = repeatLimit.load(std::memory_order_relaxed);
+    if (limit > 0 && data->messageIdNumber != 0) {
+        uint32_t seen = countRepeat(data->messageIdNumber);
+        if (seen > limit) {
+            return; // counted in the table, reported by printSummary
+        }
+        lastOne = seen == limit;
+    }
+
+    Entry entry;
+    entry.severity = severity;
+    entry.type = type;
+    entry.lastOne = lastOne;
+    const char* message = data->pMessage != nullptr ? data->pMessage : "";
+    strncpy(entry.text, message, sizeof(entry.text) - 1);
+    entry.text[sizeof(entry.text) - 1] = '\0';
+
+    if (!queue->push(entry)) {
+        droppedCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+bool ValidationLogger::drain() {
+    // One write and one flush for everything that's queued, instead of a flush per message like std::endl would do
+    std::string batch;
+    Entry entry;
+    while (queue->pop(entry)) {
+        batch += "Validation Layer [";
+        batch += severityName(entry.severity);
+        batch += "]: ";
+        batch += entry.text;
+        if (entry.lastOne) {
+            batch += " (repeat limit reached, further occurrences of this message are only counted)";
+        }
+        batch += '\n';
+    }
+    if (batch.empty()) {
+        return false;
+    }
+    std::cerr.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+    std::cerr.flush();
+    return true;
+}
+
+void ValidationLogger::writeLoop() {
+    while (running.load(std::memory_order_acquire)) {
+        if (!drain()) {
+            // Producers never wake us (that would mean a syscall in their Vulkan call), we just look again a little later
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+    drain();
+}
+
+void ValidationLogger::printSummary() {
+    for (size_t i = 0; i < repeatTableSize; i++) {
+        uint64_t key = repeatCounters[i].key.load(std::memory_order_relaxed);
+        uint32_t count = repeatCounters[i].count.load(std::memory_order_relaxed);
+        uint32_t limit = repeatLimit.load(std::memory_order_relaxed);
+        if (key != 0 && limit > 0 && count > limit) {
+            std::cerr << "Validation Layer: message id 0x" << std::hex << static_cast<uint32_t>(key) << std::dec
+                      << " repeated " << count << " times, " << (count - limit) << " not shown" << std::endl;
+        }
+    }
+    uint64_t dropped = droppedCount.load(std::memory_order_relaxed);
+    if (dropped > 0) {
+        std::cerr << "Validation Layer: " << dropped << " messages dropped, the log queue was full" << std::endl;
+    }
+}
@@ -0,0 +1,76 @@
+//
+//  helper_logger.h
+//  VulkanTesting
+//
+//  Validation layer messages, filtered and deduplicated on the calling thread and written out on a thread of our own.
+//
+
+#ifndef helper_logger_h
+#define helper_logger_h
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include "helper_mpsc_queue.h"
+
+// The debug callback runs synchronously inside whatever Vulkan call triggered it, on whichever thread made it (main or render thread).
+// Writing to std::cerr from there, with a flush per message, puts console I/O in the middle of our frame.
+// Instead the callback only filters, copies the message into a lock-free queue and returns; a background thread does the writing.
+// If the queue is full the message is dropped and counted rather than blocking the caller
+class ValidationLogger {
+    public:
+    ValidationLogger();
+    ~ValidationLogger(); // stops (and drains) if still running
+    ValidationLogger(const ValidationLogger&) = delete;
+    ValidationLogger& operator=(const ValidationLogger&) = delete;
+
+    // Only messages with one of these severities and one of these types get through. Can be changed at any time, from any thread
+    void setFilter(VkDebugUtilsMessageSeverityFlagsEXT severities, VkDebugUtilsMessageTypeFlagsEXT types);
+    VkDebugUtilsMessageSeverityFlagsEXT severities() const { return severityMask.load(std::memory_order_relaxed); }
+    VkDebugUtilsMessageTypeFlagsEXT types() const { return typeMask.load(std::memory_order_relaxed); }
+    // Messages with the same messageIdNumber are written this many times, after that only counted. 0 = no limit
+    void setRepeatLimit(uint32_t limit) { repeatLimit.store(limit, std::memory_order_relaxed); }
+
+    void start();
+    // Writes whatever is still queued, then a summary of what was suppressed or dropped
+    void stop();
+
+    // From the debug callback. Never blocks and never allocates
+    void log(VkDebugUtilsMessageSeverityFlagBitsEXT severity, VkDebugUtilsMessageTypeFlagsEXT type, const VkDebugUtilsMessengerCallbackDataEXT* data);
+
+    private:
+    struct Entry {
+        VkDebugUtilsMessageSeverityFlagBitsEXT severity;
+        VkDebugUtilsMessageTypeFlagsEXT type;
+        bool lastOne; // repeat limit reached with this one, say so when writing it
+        char text[1024]; // longer messages are cut, the start of a validation message is the useful part
+    };
+    // Open addressing on the message id, claimed with a CAS. Key 0 means empty, so the id is stored with bit 32 set
+    struct RepeatCounter {
+        std::atomic<uint64_t> key{0};
+        std::atomic<uint32_t> count{0};
+    };
+    static const size_t repeatTableSize = 512; // power of two. Once it's full, new ids are simply not deduplicated
+
+    std::unique_ptr<MpscQueue<Entry, 256>> queue; // ~256 KiB, too big to sit inside the application object
+    std::unique_ptr<RepeatCounter[]> repeatCounters;
+    std::atomic<VkDebugUtilsMessageSeverityFlagsEXT> severityMask;
+    std::atomic<VkDebugUtilsMessageTypeFlagsEXT> typeMask;
+    std::atomic<uint32_t> repeatLimit{10};
+    std::atomic<uint64_t> droppedCount{0};
+    std::atomic<bool> running{false};
+    std::thread writer;
+
+    // Returns how many times this id has been seen, this time included, or 0 if it can't be tracked
+    uint32_t countRepeat(int32_t messageId);
+    void writeLoop();
+    bool drain(); // false if there was nothing to write
+    void printSummary();
+};
+
+// Every severity from minimum up, in the form VkDebugUtilsMessengerCreateInfoEXT wants
+VkDebugUtilsMessageSeverityFlagsEXT severitiesFrom(VkDebugUtilsMessageSeverityFlagBitsEXT minimum);
+
+#endif /* helper_logger_h */
@@ -0,0 +1,77 @@
+//
+//  helper_memory_budget.cpp
+//  VulkanTesting
+//
+//  Per-heap GPU memory usage against the budget the driver gives us, from VK_EXT_memory_budget.
+//
+#include "helper_memory_budget.h"
+#include <algorithm>
+#include <iostream>
+
+static double mebibytes(VkDeviceSize bytes) {
+    return bytes / (1024.0 * 1024.0);
+}
+
+void MemoryBudgetMonitor::init(VkInstance instance, VkPhysicalDevice physicalDevice, const VkPhysicalDeviceMemoryProperties& properties, double warnFraction) {
+    this->physicalDevice = physicalDevice;
+    this->warnFraction = warnFraction;
+    // Same story as the features: on a 1.0 instance this comes from VK_KHR_get_physical_device_properties2
+    getMemoryProperties2 = (PFN_vkGetPhysicalDeviceMemoryProperties2KHR) vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2KHR");
+    if (getMemoryProperties2 == nullptr) return;
+
+    heaps.resize(properties.memoryHeapCount);
+    for (uint32_t i = 0; i < properties.memoryHeapCount; i++) {
+        heaps[i].deviceLocal = (properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+        heaps[i].size = properties.memoryHeaps[i].size;
+    }
+}
+
+void MemoryBudgetMonitor::sample(uint64_t frame) {
+    if (!enabled()) return;
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+    budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    VkPhysicalDeviceMemoryProperties2KHR properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+    properties.pNext = &budgetProperties;
+    getMemoryProperties2(physicalDevice, &properties);
+
+    for (size_t i = 0; i < heaps.size(); i++) {
+        Heap& heap = heaps[i];
+        heap.usage = budgetProperties.heapUsage[i];
+        heap.budget = budgetProperties.heapBudget[i];
+        if (heap.usage > heap.peakUsage) {
+            heap.peakUsage = heap.usage;
+        }
+        if (heap.lowestBudget == 0 || heap.budget < heap.lowestBudget) {
+            heap.lowestBudget = heap.budget;
+        }
+        if (heap.budget == 0) continue; // shouldn't happen, but a driver reporting nothing is no reason to divide by zero
+
+        double fraction = static_cast<double>(heap.usage) / heap.budget;
+        heap.usageFractionSum += fraction;
+        heap.usageFractionMax = std::max(heap.usageFractionMax, fraction);
+        heap.usageFractionSamples++;
+        // Warn on the way up, and only again once usage has come back down a bit. Otherwise a heap sitting at the threshold warns every frame
+        if (!heap.overThreshold && fraction >= warnFraction) {
+            heap.overThreshold = true;
+            std::cout << "Warning: frame " << frame << ", memory heap " << i << (heap.deviceLocal ? " (device local)" : "")
+                      << " at " << static_cast<int>(fraction * 100) << "% of its budget: "
+                      << mebibytes(heap.usage) << " of " << mebibytes(heap.budget) << " MiB" << std::endl;
+        } else if (heap.overThreshold && fraction < warnFraction - 0.05) {
+            heap.overThreshold = false;
+        }
+    }
+}
+
+void MemoryBudgetMonitor::printReport() const {
+    for (size_t i = 0; i < heaps.size(); i++) {
+        const Heap& heap = heaps[i];
+        if (heap.usageFractionSamples == 0) continue;
+        std::cout << "Memory heap " << i << (heap.deviceLocal ? " (device local)" : "") << ": " << mebibytes(heap.size) << " MiB"
+                  << ", usage peak " << mebibytes(heap.peakUsage) << " MiB"
+                  << ", budget lowest " << mebibytes(heap.lowestBudget) << " MiB"
+                  << ", usage/budget avg " << static_cast<int>(heap.usageFractionSum / heap.usageFractionSamples * 100) << "%"
+                  << " max " << static_cast<int>(heap.usageFractionMax * 100) << "%" << std::endl;
+    }
+}
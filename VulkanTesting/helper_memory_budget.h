@@ -0,0 +1,57 @@
+//
+//  helper_memory_budget.h
+//  VulkanTesting
+//
+//  Per-heap GPU memory usage against the budget the driver gives us, from VK_EXT_memory_budget.
+//
+
+#ifndef helper_memory_budget_h
+#define helper_memory_budget_h
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <cstdint>
+#include <vector>
+
+// The budget is how much of a heap this process can use before the OS starts paging or allocations start failing. It changes
+// while we run: other processes on the same GPU (shared render nodes, a compositor) eat into it. The usage includes everything
+// the driver allocated for us, not only our own vkAllocateMemory calls.
+// Sampling is one vkGetPhysicalDeviceMemoryProperties2 call, no GPU sync
+class MemoryBudgetMonitor {
+    public:
+    // The device must have been created with VK_EXT_memory_budget. properties are the device's memory properties, for the heap list.
+    // warnFraction: warn when a heap's usage goes past this share of its budget
+    void init(VkInstance instance, VkPhysicalDevice physicalDevice, const VkPhysicalDeviceMemoryProperties& properties, double warnFraction);
+    bool enabled() const { return getMemoryProperties2 != nullptr; }
+
+    // Once per frame
+    void sample(uint64_t frame);
+
+    // Latest sample
+    size_t heapCount() const { return heaps.size(); }
+    VkDeviceSize usage(size_t heap) const { return heaps[heap].usage; }
+    VkDeviceSize budget(size_t heap) const { return heaps[heap].budget; }
+    bool deviceLocal(size_t heap) const { return heaps[heap].deviceLocal; }
+    void printReport() const;
+
+    private:
+    struct Heap {
+        bool deviceLocal = false;
+        VkDeviceSize size = 0;
+        VkDeviceSize usage = 0;
+        VkDeviceSize budget = 0;
+        VkDeviceSize peakUsage = 0;
+        VkDeviceSize lowestBudget = 0;
+        // usage / budget. Sampled every frame for as long as we run, so only the running figures the report needs are kept
+        double usageFractionSum = 0.0;
+        double usageFractionMax = 0.0;
+        uint64_t usageFractionSamples = 0;
+        bool overThreshold = false; // so we warn once per crossing rather than every frame
+    };
+
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2 = nullptr;
+    double warnFraction = 0.9;
+    std::vector<Heap> heaps;
+};
+
+#endif /* helper_memory_budget_h */
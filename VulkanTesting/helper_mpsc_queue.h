@@ -0,0 +1,76 @@
+//
+//  helper_mpsc_queue.h
+//  VulkanTesting
+//
+//  Bounded lock-free queue for any number of producer threads and one consumer thread.
+//
+
+#ifndef helper_mpsc_queue_h
+#define helper_mpsc_queue_h
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Capacity must be a power of two so the indices can wrap with a mask.
+// Unlike SpscQueue several producers race for the tail, so every cell carries a sequence number saying whose turn it is:
+// a producer claims a cell with a CAS on the tail, fills it, then release-stores the sequence to hand it to the consumer.
+// The consumer, in turn, release-stores the sequence one lap ahead to hand the cell back to the producers
+template <typename T, size_t Capacity>
+class MpscQueue {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "MpscQueue capacity must be a power of two");
+
+    public:
+    MpscQueue() {
+        for (size_t i = 0; i < Capacity; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    // Producer side, from any thread. Returns false (and drops nothing) if the queue is full
+    bool push(const T& item) {
+        size_t tail = tailIndex.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells[tail & (Capacity - 1)];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            if (sequence == tail) {
+                // The cell is free for this lap, try to claim it. On failure tail is reloaded and we go again
+                if (tailIndex.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed)) {
+                    cell.item = item;
+                    cell.sequence.store(tail + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (sequence < tail) {
+                return false; // still holds an item from the previous lap the consumer hasn't taken: full
+            } else {
+                tail = tailIndex.load(std::memory_order_relaxed); // another producer got here first
+            }
+        }
+    }
+
+    // Consumer side, one thread only. Returns false if there was nothing to pop (or the next item is still being written)
+    bool pop(T& item) {
+        size_t head = headIndex.load(std::memory_order_relaxed);
+        Cell& cell = cells[head & (Capacity - 1)];
+        if (cell.sequence.load(std::memory_order_acquire) != head + 1) {
+            return false;
+        }
+        item = cell.item;
+        cell.sequence.store(head + Capacity, std::memory_order_release);
+        headIndex.store(head + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T item;
+    };
+    std::array<Cell, Capacity> cells;
+    // Same as SpscQueue: keep the contended indices away from each other and from the cells
+    alignas(64) std::atomic<size_t> headIndex{0};
+    alignas(64) std::atomic<size_t> tailIndex{0};
+};
+
+#endif /* helper_mpsc_queue_h */
@@ -0,0 +1,294 @@
+//
+//  helper_options.cpp
+//  VulkanTesting
+//
+//  Startup options. Everything that can be tuned without recompiling lives here.
+//
+#include "helper_options.h"
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+
+// Splits "--name=value" into its two halves. value is empty for plain flags such as "--help"
+static void splitArgument(const std::string& argument, std::string& name, std::string& value) {
+    size_t equals = argument.find('=');
+    name = argument.substr(0, equals);
+    value = equals == std::string::npos ? "" : argument.substr(equals + 1);
+}
+
+static uint32_t parseUnsigned(const std::string& name, const std::string& value) {
+    // stoul would take "-1" as ULONG_MAX, and values that don't fit in our uint32_t options
+    if (value.find('-') == std::string::npos) {
+        try {
+            size_t consumed = 0;
+            unsigned long parsed = std::stoul(value, &consumed);
+            if (consumed == value.size() && parsed <= UINT32_MAX) {
+                return static_cast<uint32_t>(parsed);
+            }
+        } catch (const std::exception&) {
+            // fall through to our own, more helpful, error
+        }
+    }
+    throw std::runtime_error("Invalid value for " + name + ": '" + value + "'");
+}
+
+static double parseDouble(const std::string& name, const std::string& value) {
+    try {
+        size_t consumed = 0;
+        double parsed = std::stod(value, &consumed);
+        if (consumed == value.size()) {
+            return parsed;
+        }
+    } catch (const std::exception&) {
+        // same as parseUnsigned
+    }
+    throw std::runtime_error("Invalid value for " + name + ": '" + value + "'");
+}
+
+static PresentPolicy parsePresentPolicy(const std::string& name, const std::string& value) {
+    for (PresentPolicy policy : {PresentPolicy::LowLatency, PresentPolicy::MaxThroughput, PresentPolicy::PowerSaving}) {
+        if (value == presentPolicyName(policy)) {
+            return policy;
+        }
+    }
+    throw std::runtime_error("Invalid value for " + name + ": '" + value + "'");
+}
+
+static LogSeverity parseLogSeverity(const std::string& name, const std::string& value) {
+    for (LogSeverity severity : {LogSeverity::Verbose, LogSeverity::Info, LogSeverity::Warning, LogSeverity::Error}) {
+        if (value == logSeverityName(severity)) {
+            return severity;
+        }
+    }
+    throw std::runtime_error("Invalid value for " + name + ": '" + value + "'");
+}
+
+// Comma separated list of message types, only the ones listed are logged
+static void parseLogTypes(const std::string& name, const std::string& value, AppOptions& options) {
+    options.logGeneral = options.logValidation = options.logPerformance = false;
+    size_t start = 0;
+    while (start <= value.size()) {
+        size_t comma = value.find(',', start);
+        std::string type = value.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+        if (type == "general") {
+            options.logGeneral = true;
+        } else if (type == "validation") {
+            options.logValidation = true;
+        } else if (type == "performance") {
+            options.logPerformance = true;
+        } else {
+            throw std::runtime_error("Invalid value for " + name + ": '" + type + "'");
+        }
+        if (comma == std::string::npos) break;
+        start = comma + 1;
+    }
+}
+
+static ValidationMode parseValidationMode(const std::string& name, const std::string& value) {
+    for (ValidationMode mode : {ValidationMode::Off, ValidationMode::Full, ValidationMode::Performance}) {
+        if (value == validationModeName(mode)) {
+            return mode;
+        }
+    }
+    throw std::runtime_error("Invalid value for " + name + ": '" + value + "'");
+}
+
+const char* validationModeName(ValidationMode mode) {
+    switch (mode) {
+        case ValidationMode::Off: return "off";
+        case ValidationMode::Full: return "full";
+        case ValidationMode::Performance: return "perf";
+    }
+    return "unknown";
+}
+
+const char* logSeverityName(LogSeverity severity) {
+    switch (severity) {
+        case LogSeverity::Verbose: return "verbose";
+        case LogSeverity::Info: return "info";
+        case LogSeverity::Warning: return "warning";
+        case LogSeverity::Error: return "error";
+    }
+    return "unknown";
+}
+
+const char* presentPolicyName(PresentPolicy policy) {
+    switch (policy) {
+        case PresentPolicy::LowLatency: return "low-latency";
+        case PresentPolicy::MaxThroughput: return "throughput";
+        case PresentPolicy::PowerSaving: return "power-saving";
+    }
+    return "unknown";
+}
+
+AppOptions parseOptions(int argc, const char* const* argv) {
+    AppOptions options;
+
+    // Environment first, so a command line option can still override it. Handy for turning validation on in a build we can't pass arguments to
+    if (const char* validation = std::getenv("VULKAN_TESTING_VALIDATION")) {
+        options.validation = parseValidationMode("VULKAN_TESTING_VALIDATION", validation);
+    }
+
+    for (int i = 1; i < argc; i++) {
+        std::string name, value;
+        splitArgument(argv[i], name, value);
+
+        if (name == "--help" || name == "-h") {
+            printUsage(argv[0]);
+            std::exit(EXIT_SUCCESS); // asking for help isn't an error, and there's nothing to run
+        } else if (name == "--frames-in-flight") {
+            options.maxFramesInFlight = parseUnsigned(name, value);
+            if (options.maxFramesInFlight == 0) {
+                throw std::runtime_error("--frames-in-flight must be at least 1");
+            }
+        } else if (name == "--present") {
+            options.presentPolicy = parsePresentPolicy(name, value);
+        } else if (name == "--present-sweep") {
+            options.presentSweepSeconds = parseDouble(name, value);
+        } else if (name == "--pace") {
+            options.maxQueuedPresents = parseUnsigned(name, value);
+        } else if (name == "--latency-log") {
+            options.logFrameLatency = true;
+        } else if (name == "--on-demand") {
+            options.onDemand = true;
+            if (!value.empty()) {
+                options.onDemandRefreshSeconds = parseDouble(name, value);
+            }
+        } else if (name == "--render-thread") {
+            options.renderThread = true;
+        } else if (name == "--fps") {
+            double fps = parseDouble(name, value);
+            options.targetFrameSeconds = fps > 0.0 ? 1.0 / fps : 0.0;
+        } else if (name == "--frame-time") {
+            options.targetFrameSeconds = parseDouble(name, value) / 1000.0;
+        } else if (name == "--hud") {
+            options.hud = true;
+        } else if (name == "--device") {
+            if (value.empty()) {
+                throw std::runtime_error("--device needs an index or a UUID");
+            }
+            options.device = value;
+        } else if (name == "--device-cache") {
+            if (value.empty()) {
+                throw std::runtime_error("--device-cache needs a file name or off");
+            }
+            options.deviceCachePath = value;
+        } else if (name == "--verbose") {
+            options.verbose = true;
+        } else if (name == "--trace") {
+            if (value.empty()) {
+                throw std::runtime_error("--trace needs a file name");
+            }
+            options.tracePath = value;
+        } else if (name == "--pipeline-stats-log") {
+            options.logPipelineStatistics = true;
+        } else if (name == "--validation") {
+            options.validation = parseValidationMode(name, value);
+        } else if (name == "--log-severity") {
+            options.logSeverity = parseLogSeverity(name, value);
+        } else if (name == "--log-types") {
+            parseLogTypes(name, value, options);
+        } else if (name == "--log-repeats") {
+            options.logRepeats = parseUnsigned(name, value);
+        } else if (name == "--budget-warn") {
+            options.memoryBudgetWarning = parseDouble(name, value) / 100.0;
+        } else if (name == "--host-alloc") {
+            if (value == "track" || value == "pool") {
+                options.trackHostAllocations = true;
+                options.poolHostAllocations = value == "pool";
+            } else if (value == "off") {
+                options.trackHostAllocations = options.poolHostAllocations = false;
+            } else {
+                throw std::runtime_error("Invalid value for " + name + ": '" + value + "'");
+            }
+        } else if (name == "--headless") {
+            options.headless = true;
+        } else if (name == "--frames") {
+            options.frameLimit = parseUnsigned(name, value);
+        } else if (name == "--benchmark") {
+            options.benchmarkFrames = parseUnsigned(name, value);
+        } else if (name == "--warmup") {
+            options.warmupFrames = parseUnsigned(name, value);
+        } else if (name == "--report") {
+            if (value.empty()) {
+                throw std::runtime_error("--report needs a file name");
+            }
+            options.reportPath = value;
+        } else if (name == "--baseline" || name == "--write-baseline") {
+            if (value.empty()) {
+                throw std::runtime_error(name + " needs a file name");
+            }
+            (name == "--baseline" ? options.baselinePath : options.writeBaselinePath) = value;
+        } else if (name == "--tolerance") {
+            options.baselineTolerance = parseDouble(name, value) / 100.0;
+        } else if (name == "--draws") {
+            options.drawsPerFrame = parseUnsigned(name, value);
+            if (options.drawsPerFrame == 0) {
+                throw std::runtime_error("--draws needs at least one draw");
+            }
+        } else {
+            printUsage(argv[0]);
+            throw std::runtime_error("Unknown option " + name);
+        }
+    }
+
+    if ((!options.baselinePath.empty() || !options.writeBaselinePath.empty()) && options.benchmarkFrames == 0) {
+        throw std::runtime_error("--baseline and --write-baseline compare benchmark runs, they need --benchmark");
+    }
+
+    if (options.benchmarkFrames > 0) {
+        // Every run has to do the same work to be comparable: a fixed number of frames, drawn back to back, with one present policy
+        options.frameLimit = options.warmupFrames + options.benchmarkFrames;
+        options.onDemand = false;
+        options.presentSweepSeconds = 0.0;
+    }
+
+    if (options.headless) {
+        // Nothing to present means no window events to hand off, no present modes to compare and no changes to wait for
+        options.renderThread = false;
+        options.presentSweepSeconds = 0.0;
+        options.onDemand = false;
+        if (options.frameLimit == 0) {
+            options.frameLimit = 300;
+        }
+    }
+
+    return options;
+}
+
+void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]" << std::endl;
+    std::cout << "  --frames-in-flight=N   frames the CPU may queue ahead of the GPU (default 2)" << std::endl;
+    std::cout << "  --present=POLICY       low-latency (default), throughput or power-saving" << std::endl;
+    std::cout << "  --present-sweep=S      spend S seconds on each present policy and report latency/throughput for each" << std::endl;
+    std::cout << "  --pace=K               with VK_KHR_present_wait, start a frame only when at most K presents are queued (0 = off)" << std::endl;
+    std::cout << "  --latency-log          print input-to-photon latency for every frame (needs VK_KHR_present_wait)" << std::endl;
+    std::cout << "  --on-demand[=S]        only render when input or window state changes, and at least every S seconds if given" << std::endl;
+    std::cout << "  --render-thread        render on a dedicated thread, the main thread only handles window events" << std::endl;
+    std::cout << "  --fps=N                limit the frame rate to N frames per second" << std::endl;
+    std::cout << "  --frame-time=MS        limit the frame rate to one frame every MS milliseconds" << std::endl;
+    std::cout << "  --hud                  show the performance overlay (frame time graph, FPS, GPU time, memory). F1 toggles it" << std::endl;
+    std::cout << "  --device=INDEX|UUID    use this GPU instead of the best scoring one (--verbose lists them with their UUIDs)" << std::endl;
+    std::cout << "  --device-cache=FILE    where to remember the chosen GPU (default ~/.cache/VulkanTesting/device), off to always score them all" << std::endl;
+    std::cout << "  --verbose              list extensions, layers and GPUs at startup" << std::endl;
+    std::cout << "  --trace=FILE           write a Chrome/Perfetto trace of the startup stages to FILE" << std::endl;
+    std::cout << "  --pipeline-stats-log   print vertex/clipping/fragment counters for every frame" << std::endl;
+    std::cout << "  --validation=MODE      off, full or perf (best practices only). Default full in debug builds, off in release," << std::endl;
+    std::cout << "                         also settable with the VULKAN_TESTING_VALIDATION environment variable" << std::endl;
+    std::cout << "  --log-severity=LEVEL   validation messages to show: verbose, info, warning (default) or error and up" << std::endl;
+    std::cout << "  --log-types=LIST       comma separated validation message types: general, validation, performance (default all)" << std::endl;
+    std::cout << "  --log-repeats=N        show the same validation message at most N times, then only count it (default 10, 0 = no limit)" << std::endl;
+    std::cout << "  --budget-warn=PERCENT  warn when a GPU memory heap passes PERCENT of its budget (default 90, needs VK_EXT_memory_budget)" << std::endl;
+    std::cout << "  --host-alloc=MODE      off (default), track (count the driver's host allocations) or pool (also pool the short-lived ones)" << std::endl;
+    std::cout << "  --headless             render offscreen without a window or display, e.g. on a software ICD such as lavapipe" << std::endl;
+    std::cout << "  --frames=N             exit after N frames (headless default 300)" << std::endl;
+    std::cout << "  --benchmark=N          after the warmup, time N frames, write a JSON report and exit" << std::endl;
+    std::cout << "  --warmup=M             frames rendered before a benchmark starts measuring (default 60)" << std::endl;
+    std::cout << "  --report=FILE          where the benchmark report goes (default benchmark.json)" << std::endl;
+    std::cout << "  --baseline=FILE        compare the benchmark against a stored baseline, exit with an error if it regressed" << std::endl;
+    std::cout << "  -h, --help             show this and exit" << std::endl;
+    std::cout << "  --write-baseline=FILE  store the benchmark's results as a baseline" << std::endl;
+    std::cout << "  --tolerance=PERCENT    how much worse than the baseline still passes (default 10)" << std::endl;
+    std::cout << "  --draws=N              draw the triangle N times per frame (default 1)" << std::endl;
+}
@@ -0,0 +1,105 @@
+//
+//  helper_options.h
+//  VulkanTesting
+//
+//  Startup options. Everything that can be tuned without recompiling lives here.
+//
+
+#ifndef helper_options_h
+#define helper_options_h
+#include <cstdint>
+#include <string>
+
+// What we optimize presentation for. Each one maps to a preferred present mode and swapchain image count
+enum class PresentPolicy {
+    LowLatency,    // show the newest frame as soon as possible without tearing (MAILBOX)
+    MaxThroughput, // render as many frames as possible, tearing allowed (IMMEDIATE)
+    PowerSaving    // never render faster than the display refreshes (FIFO_RELAXED/FIFO)
+};
+
+const char* presentPolicyName(PresentPolicy policy);
+
+// Least severe validation layer message that still gets logged
+enum class LogSeverity {
+    Verbose,
+    Info,
+    Warning,
+    Error
+};
+
+const char* logSeverityName(LogSeverity severity);
+
+// Which validation the Khronos validation layer does
+enum class ValidationMode {
+    Off,
+    Full,       // everything the layer checks by default
+    Performance // only best practices (VK_EXT_validation_features), for auditing release-like runs for performance anti-patterns
+};
+
+const char* validationModeName(ValidationMode mode);
+
+struct AppOptions {
+    // How many frames the CPU is allowed to record/submit ahead of the GPU. More frames means more CPU/GPU overlap but also more latency
+    uint32_t maxFramesInFlight = 2;
+    PresentPolicy presentPolicy = PresentPolicy::LowLatency;
+    // When > 0, cycle through every present policy spending this many seconds on each, and report how each one did
+    double presentSweepSeconds = 0.0;
+    // Needs VK_KHR_present_wait. When > 0, hold off starting a frame until at most this many presents are waiting to reach the display
+    uint32_t maxQueuedPresents = 0;
+    bool logFrameLatency = false; // print input-to-photon latency for every frame (needs VK_KHR_present_wait)
+    // Only render when something changed (input, resize...) and otherwise sleep in glfwWaitEvents. Useful for mostly static content
+    bool onDemand = false;
+    double onDemandRefreshSeconds = 0.0; // with onDemand, also redraw at least this often (0 = only on changes)
+    // Render on a thread of its own while the main thread only pumps GLFW events, so neither can hold up the other
+    bool renderThread = false;
+    // Frame limiter target, 0 = unlimited. Keeps modes like MAILBOX/IMMEDIATE from rendering frames nobody will see
+    double targetFrameSeconds = 0.0;
+    // No window, no surface: render into images we own and never present them. For machines without a display (CI, render nodes, lavapipe)
+    bool headless = false;
+    // Stop after this many frames, 0 = run until the window is closed. Headless runs default to 300 since there's no window to close
+    uint32_t frameLimit = 0;
+    // Benchmark run: render warmupFrames, then measure benchmarkFrames more, write a JSON report to reportPath and exit. 0 = off
+    uint32_t benchmarkFrames = 0;
+    uint32_t warmupFrames = 60;
+    std::string reportPath = "benchmark.json";
+    // Regression checks on a benchmark run: compare against a stored baseline and fail if anything got worse by more than
+    // baselineTolerance (0.1 = 10%), and/or store this run as the new baseline
+    std::string baselinePath;
+    std::string writeBaselinePath;
+    double baselineTolerance = 0.1;
+    // Draw calls per frame, the same triangle each time. Makes the scene heavy enough on the CPU side of the driver to measure draw call throughput
+    uint32_t drawsPerFrame = 1;
+    // Which GPU to use: its index in enumeration order or its deviceUUID. Empty: the best scoring one, remembered in deviceCachePath
+    // (empty: the default location, "off": don't remember) so later starts don't have to look at every GPU again
+    std::string device;
+    std::string deviceCachePath;
+    bool verbose = false; // print extensions, devices and files as they're looked at. Off by default to keep startup quiet and fast
+    std::string tracePath; // when set, write a Chrome trace of the startup stages here
+    bool logPipelineStatistics = false; // print each frame's pipeline statistics counters as they are read back
+    // Debug builds validate by default and release builds don't, either can be overridden with VULKAN_TESTING_VALIDATION or --validation
+#ifdef NDEBUG
+    ValidationMode validation = ValidationMode::Off;
+#else
+    ValidationMode validation = ValidationMode::Full;
+#endif
+    // Validation layer messages: minimum severity, which message types, and how often the same message may repeat (0 = always)
+    LogSeverity logSeverity = LogSeverity::Warning;
+    bool logGeneral = true;
+    bool logValidation = true;
+    bool logPerformance = true;
+    uint32_t logRepeats = 10;
+    // Warn when a GPU memory heap's usage passes this share of its VK_EXT_memory_budget budget
+    double memoryBudgetWarning = 0.9;
+    // Give the driver our own VkAllocationCallbacks and report its host allocations per object and scope. With pooling, small
+    // command/object scope allocations come from free lists instead of malloc
+    bool trackHostAllocations = false;
+    bool poolHostAllocations = false;
+    // Start with the performance overlay shown. F1 toggles it either way
+    bool hud = false;
+};
+
+// Parses "--name=value" style arguments, after the environment variables (VULKAN_TESTING_VALIDATION). Throws std::runtime_error on anything it does not understand
+AppOptions parseOptions(int argc, const char* const* argv);
+void printUsage(const char* program);
+
+#endif /* helper_options_h */
@@ -0,0 +1,72 @@
+//
+//  helper_present_wait.cpp
+//  VulkanTesting
+//
+//  Keeps track of presents until they reach the display, and records when they did.
+//
+#include "helper_present_wait.h"
+
+// Pacing on a present that never makes it to the display (e.g. the window got hidden) would block forever. One that takes this long isn't coming
+static const uint64_t giveUpNanoseconds = 1000000000;
+
+void PresentWaiter::init(VkDevice device, PFN_vkWaitForPresentKHR waitForPresent) {
+    this->device = device;
+    this->waitForPresent = waitForPresent;
+}
+
+void PresentWaiter::watch(VkSwapchainKHR swapchain, uint64_t presentId, Clock::time_point inputTime, bool fromInput) {
+    pending.push_back({swapchain, presentId, inputTime, fromInput});
+}
+
+void PresentWaiter::forget(VkSwapchainKHR swapchain) {
+    for (auto it = pending.begin(); it != pending.end();) {
+        it = it->swapchain == swapchain ? pending.erase(it) : it + 1;
+    }
+}
+
+void PresentWaiter::clear() {
+    pending.clear();
+    presented.clear();
+}
+
+void PresentWaiter::waitUntilPendingBelow(size_t maximum) {
+    while (pending.size() >= maximum) {
+        if (!waitForOldest(giveUpNanoseconds)) {
+            pending.pop_front(); // not worth measuring, and not worth pacing on
+        }
+    }
+}
+
+void PresentWaiter::waitUntil(Clock::time_point deadline) {
+    while (!pending.empty()) {
+        Clock::duration remaining = deadline - Clock::now();
+        uint64_t timeout = remaining > Clock::duration::zero() ? std::chrono::duration_cast<std::chrono::nanoseconds>(remaining).count() : 0;
+        if (!waitForOldest(timeout)) return;
+    }
+}
+
+void PresentWaiter::takePresented(std::vector<Presented>& frames) {
+    frames.clear();
+    frames.swap(presented);
+}
+
+bool PresentWaiter::waitForOldest(uint64_t timeoutNanoseconds) {
+    const Pending& oldest = pending.front();
+    // Check first: if it was already on screen, returning now says nothing about when it got there
+    bool exact = false;
+    VkResult result = waitForPresent(device, oldest.swapchain, oldest.presentId, 0);
+    if (result == VK_TIMEOUT) {
+        if (timeoutNanoseconds == 0) return false;
+        result = waitForPresent(device, oldest.swapchain, oldest.presentId, timeoutNanoseconds);
+        if (result == VK_TIMEOUT) return false;
+        exact = true;
+    }
+    Clock::time_point now = Clock::now();
+
+    // Anything else (e.g. out of date, the swapchain was replaced) means this present will never be reported
+    if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) {
+        presented.push_back({oldest.presentId, oldest.inputTime, oldest.fromInput, now, exact});
+    }
+    pending.pop_front();
+    return true;
+}
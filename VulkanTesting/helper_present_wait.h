@@ -0,0 +1,69 @@
+//
+//  helper_present_wait.h
+//  VulkanTesting
+//
+//  Keeps track of presents until they reach the display, and records when they did.
+//
+
+#ifndef helper_present_wait_h
+#define helper_present_wait_h
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// vkWaitForPresentKHR returns when a present is on screen, but it needs the swapchain externally synchronized with presenting, acquiring
+// and recreating it. So everything here runs on the thread that does those, which is all the synchronization it takes: no lock, no thread.
+// That thread waits in vkWaitForPresentKHR instead of sleeping wherever it has time to spare (pacing on the display, the frame limiter's
+// sleep). A present that completes during such a wait gets its exact display time. One that completes while the thread is busy
+// elsewhere is only noticed by the next call, and its display time is when we noticed: Presented::exact tells them apart
+class PresentWaiter {
+    public:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Presented {
+        uint64_t presentId;
+        Clock::time_point inputTime; // when the input this frame reacts to happened
+        bool fromInput; // false: there was no new input, inputTime is when the frame sampled its state
+        Clock::time_point displayTime; // when vkWaitForPresentKHR said it was on screen
+        bool exact; // we were inside the wait when it returned. Otherwise displayTime is a later bound
+    };
+
+    void init(VkDevice device, PFN_vkWaitForPresentKHR waitForPresent);
+    bool enabled() const { return waitForPresent != nullptr; }
+
+    // A present that vkQueuePresentKHR accepted, VK_SUBOPTIMAL_KHR included: those are still shown
+    void watch(VkSwapchainKHR swapchain, uint64_t presentId, Clock::time_point inputTime, bool fromInput);
+    // Before the swapchain is destroyed. Its pending presents will never be reported
+    void forget(VkSwapchainKHR swapchain);
+    // Drops everything pending or presented, e.g. when starting a new measurement
+    void clear();
+
+    size_t pendingCount() const { return pending.size(); }
+    // Blocks until fewer than maximum presents are still waiting for the display
+    void waitUntilPendingBelow(size_t maximum);
+    // Waits for pending presents until deadline, returning early once none are left. A deadline in the past only checks
+    void waitUntil(Clock::time_point deadline);
+    // Everything that reached the display since the last call, oldest first. Swapped into frames, so its buffer gets reused
+    void takePresented(std::vector<Presented>& frames);
+
+    private:
+    struct Pending {
+        VkSwapchainKHR swapchain;
+        uint64_t presentId;
+        Clock::time_point inputTime;
+        bool fromInput;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    PFN_vkWaitForPresentKHR waitForPresent = nullptr;
+    std::deque<Pending> pending; // presents complete in order, so only the oldest is ever waited on
+    std::vector<Presented> presented;
+
+    // Waits up to timeout for the oldest pending present. False if it's still pending
+    bool waitForOldest(uint64_t timeoutNanoseconds);
+};
+
+#endif /* helper_present_wait_h */
@@ -0,0 +1,110 @@
+//
+//  helper_queues.cpp
+//  VulkanTesting
+//
+//  Which device queue does what: graphics, present, async compute and transfers, and the queues to create for them.
+//
+#include "helper_queues.h"
+#include <iostream>
+
+// Priorities only matter between queues of the same device, and drivers are free to ignore them. The frame comes first,
+// compute next, and uploads last: they're usually not in a hurry, and shouldn't steal time from rendering when they are
+static const float graphicsPriority = 1.0f;
+static const float computePriority = 0.5f;
+static const float transferPriority = 0.25f;
+
+const char* queueRoleName(QueueRole role) {
+    switch (role) {
+        case QueueRole::Graphics: return "graphics";
+        case QueueRole::Present: return "present";
+        case QueueRole::Compute: return "compute";
+        case QueueRole::Transfer: return "transfer";
+        case QueueRole::Count: break;
+    }
+    return "unknown";
+}
+
+bool QueuePlan::claim(const std::vector<VkQueueFamilyProperties>& families, QueueRole role, uint32_t family, float priority) {
+    std::vector<float>* priorities = nullptr;
+    for (auto& entry : familyPriorities) {
+        if (entry.first == family) {
+            priorities = &entry.second;
+        }
+    }
+    if (priorities == nullptr) {
+        familyPriorities.emplace_back(family, std::vector<float>());
+        priorities = &familyPriorities.back().second;
+    }
+    if (priorities->size() >= families[family].queueCount) return false; // all taken
+
+    Queue& queue = queues[static_cast<size_t>(role)];
+    queue.family = family;
+    queue.index = static_cast<uint32_t>(priorities->size());
+    queue.priority = priority;
+    queue.shared = false;
+    priorities->push_back(priority);
+    return true;
+}
+
+void QueuePlan::share(QueueRole role, QueueRole with) {
+    const Queue& owner = queue(with);
+    Queue& queue = queues[static_cast<size_t>(role)];
+    queue = owner;
+    queue.shared = true;
+    queue.sharedWith = owner.shared ? owner.sharedWith : with; // always name the role that really owns it
+}
+
+QueuePlan QueuePlan::make(const std::vector<VkQueueFamilyProperties>& families, uint32_t graphicsFamily, uint32_t presentFamily,
+                          std::optional<uint32_t> computeFamily, std::optional<uint32_t> transferFamily) {
+    QueuePlan plan;
+    plan.claim(families, QueueRole::Graphics, graphicsFamily, graphicsPriority); // every family has at least one queue
+
+    // Presenting from the graphics queue is the common case and needs no hand-over of the image between queues
+    if (presentFamily == graphicsFamily || !plan.claim(families, QueueRole::Present, presentFamily, graphicsPriority)) {
+        plan.share(QueueRole::Present, QueueRole::Graphics);
+    }
+
+    // A compute-only family runs beside graphics on separate hardware queues. Failing that, a second queue in the graphics
+    // family still lets the driver interleave the two
+    bool computeClaimed = (computeFamily.has_value() && plan.claim(families, QueueRole::Compute, computeFamily.value(), computePriority))
+                          || plan.claim(families, QueueRole::Compute, graphicsFamily, computePriority);
+    if (!computeClaimed) {
+        plan.share(QueueRole::Compute, QueueRole::Graphics);
+    }
+
+    // Any family with graphics or compute can also do transfers, so after the dedicated one the others are fallbacks
+    bool transferClaimed = (transferFamily.has_value() && plan.claim(families, QueueRole::Transfer, transferFamily.value(), transferPriority))
+                           || (computeFamily.has_value() && plan.claim(families, QueueRole::Transfer, computeFamily.value(), transferPriority))
+                           || plan.claim(families, QueueRole::Transfer, graphicsFamily, transferPriority);
+    if (!transferClaimed) {
+        // Rather behind compute than behind the frame
+        plan.share(QueueRole::Transfer, plan.queue(QueueRole::Compute).shared ? QueueRole::Graphics : QueueRole::Compute);
+    }
+    return plan;
+}
+
+std::vector<VkDeviceQueueCreateInfo> QueuePlan::createInfos() const {
+    std::vector<VkDeviceQueueCreateInfo> infos;
+    for (const auto& entry : familyPriorities) {
+        if (entry.second.empty()) continue; // a family we looked at but got nothing from
+        VkDeviceQueueCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        info.queueFamilyIndex = entry.first;
+        info.queueCount = static_cast<uint32_t>(entry.second.size());
+        info.pQueuePriorities = entry.second.data();
+        infos.push_back(info);
+    }
+    return infos;
+}
+
+void QueuePlan::print() const {
+    for (size_t i = 0; i < queues.size(); i++) {
+        const Queue& queue = queues[i];
+        std::cout << "Queue " << queueRoleName(static_cast<QueueRole>(i)) << ": family " << queue.family << " index " << queue.index;
+        if (queue.shared) {
+            std::cout << ", shared with " << queueRoleName(queue.sharedWith) << std::endl;
+        } else {
+            std::cout << ", priority " << queue.priority << std::endl;
+        }
+    }
+}
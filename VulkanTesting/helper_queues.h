@@ -0,0 +1,57 @@
+//
+//  helper_queues.h
+//  VulkanTesting
+//
+//  Which device queue does what: graphics, present, async compute and transfers, and the queues to create for them.
+//
+
+#ifndef helper_queues_h
+#define helper_queues_h
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <array>
+#include <optional>
+#include <utility>
+#include <vector>
+
+enum class QueueRole {
+    Graphics,
+    Present,
+    Compute,  // async compute, alongside the frame
+    Transfer, // uploads and readbacks, ideally on the copy engine
+    Count
+};
+
+const char* queueRoleName(QueueRole role);
+
+// Every role gets its own VkQueue when the device has one to spare, preferring dedicated families: a compute-only family for compute,
+// a transfer-only one for transfers. Work on different queues can overlap on the GPU, work on the same queue runs in submission order.
+// When there's nothing to spare a role shares another role's queue, which still works, it just serializes with it
+class QueuePlan {
+    public:
+    struct Queue {
+        uint32_t family = 0;
+        uint32_t index = 0; // within the family, for vkGetDeviceQueue
+        float priority = 1.0f;
+        bool shared = false; // same VkQueue as sharedWith
+        QueueRole sharedWith = QueueRole::Graphics;
+    };
+
+    // computeFamily/transferFamily: dedicated families if the device has them (compute without graphics, transfer without either)
+    static QueuePlan make(const std::vector<VkQueueFamilyProperties>& families, uint32_t graphicsFamily, uint32_t presentFamily,
+                          std::optional<uint32_t> computeFamily, std::optional<uint32_t> transferFamily);
+
+    const Queue& queue(QueueRole role) const { return queues[static_cast<size_t>(role)]; }
+    // For VkDeviceCreateInfo. They point into the plan, so keep it around until vkCreateDevice returns
+    std::vector<VkDeviceQueueCreateInfo> createInfos() const;
+    void print() const;
+
+    private:
+    std::array<Queue, static_cast<size_t>(QueueRole::Count)> queues;
+    std::vector<std::pair<uint32_t, std::vector<float>>> familyPriorities; // the queues to create in each family, by index
+
+    bool claim(const std::vector<VkQueueFamilyProperties>& families, QueueRole role, uint32_t family, float priority);
+    void share(QueueRole role, QueueRole with);
+};
+
+#endif /* helper_queues_h */
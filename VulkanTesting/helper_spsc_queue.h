@@ -0,0 +1,56 @@
+//
+//  helper_spsc_queue.h
+//  VulkanTesting
+//
+//  Bounded lock-free queue for exactly one producer thread and one consumer thread.
+//
+
+#ifndef helper_spsc_queue_h
+#define helper_spsc_queue_h
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Capacity must be a power of two so the indices can wrap with a mask.
+// The producer only ever writes tail and the consumer only ever writes head, so neither side needs a lock:
+// publishing an element is a release store of tail, and the consumer's acquire load of tail makes the element visible.
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+    public:
+    // Producer side. Returns false (and drops nothing) if the queue is full
+    bool push(const T& item) {
+        size_t tail = tailIndex.load(std::memory_order_relaxed);
+        if (tail - headIndex.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        items[tail & (Capacity - 1)] = item;
+        tailIndex.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns false if there was nothing to pop
+    bool pop(T& item) {
+        size_t head = headIndex.load(std::memory_order_relaxed);
+        if (head == tailIndex.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = items[head & (Capacity - 1)];
+        headIndex.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Only a hint when called from the producer, exact when called from the consumer
+    bool empty() const {
+        return headIndex.load(std::memory_order_acquire) == tailIndex.load(std::memory_order_acquire);
+    }
+
+    private:
+    std::array<T, Capacity> items;
+    // Kept on separate cache lines so the two threads don't keep stealing the line from each other
+    alignas(64) std::atomic<size_t> headIndex{0};
+    alignas(64) std::atomic<size_t> tailIndex{0};
+};
+
+#endif /* helper_spsc_queue_h */
@@ -0,0 +1,59 @@
+//
+//  helper_stats.cpp
+//  VulkanTesting
+//
+//  Small sample collector for timings (frame times, latencies...) with the usual summaries.
+//
+#include "helper_stats.h"
+#include <algorithm>
+#include <cmath>
+
+void SampleStats::add(double sample) {
+    added++;
+    if (capacity == unbounded || samples.size() < capacity) {
+        samples.push_back(sample);
+        return;
+    }
+    samples[next] = sample;
+    next = (next + 1) % capacity;
+}
+
+double SampleStats::mean() const {
+    if (samples.empty()) return 0.0;
+    double sum = 0.0;
+    for (double sample : samples) {
+        sum += sample;
+    }
+    return sum / samples.size();
+}
+
+double SampleStats::min() const {
+    if (samples.empty()) return 0.0;
+    return *std::min_element(samples.begin(), samples.end());
+}
+
+double SampleStats::max() const {
+    if (samples.empty()) return 0.0;
+    return *std::max_element(samples.begin(), samples.end());
+}
+
+double SampleStats::stddev() const {
+    if (samples.size() < 2) return 0.0;
+    double average = mean();
+    double sumOfSquares = 0.0;
+    for (double sample : samples) {
+        sumOfSquares += (sample - average) * (sample - average);
+    }
+    return std::sqrt(sumOfSquares / (samples.size() - 1));
+}
+
+double SampleStats::percentile(double p) const {
+    if (samples.empty()) return 0.0;
+    std::vector<double> sorted(samples);
+    // nearest-rank: the smallest sample with at least p% of the samples at or below it
+    size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size()));
+    rank = std::min(std::max<size_t>(rank, 1), sorted.size());
+    // Only that one has to be in place, not a full sort of a window that may be thousands of samples long
+    std::nth_element(sorted.begin(), sorted.begin() + (rank - 1), sorted.end());
+    return sorted[rank - 1];
+}
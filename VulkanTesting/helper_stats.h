@@ -0,0 +1,42 @@
+//
+//  helper_stats.h
+//  VulkanTesting
+//
+//  Small sample collector for timings (frame times, latencies...) with the usual summaries.
+//
+
+#ifndef helper_stats_h
+#define helper_stats_h
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Keeps the last capacity samples in a ring, so something sampled every frame doesn't grow for as long as the window stays open.
+// The summaries describe that window. Only recordings of a known length (a benchmark run) should keep everything
+class SampleStats {
+    public:
+    static const size_t defaultCapacity = 16384; // minutes of frames, 128 KiB
+    static const size_t unbounded = 0;
+
+    explicit SampleStats(size_t capacity = defaultCapacity) : capacity(capacity) {}
+    void add(double sample);
+    void clear() { samples.clear(); next = 0; added = 0; }
+    size_t count() const { return samples.size(); } // in the window
+    uint64_t total() const { return added; } // since the last clear(), including those that dropped out of the window
+    bool empty() const { return samples.empty(); }
+
+    double mean() const;
+    double min() const;
+    double max() const;
+    double stddev() const;
+    // p in [0, 100], nearest-rank. Sorts a copy, so don't call it on the hot path
+    double percentile(double p) const;
+
+    private:
+    size_t capacity;
+    std::vector<double> samples; // not in order once the ring wraps, none of the summaries care
+    size_t next = 0; // oldest sample, overwritten next once full
+    uint64_t added = 0;
+};
+
+#endif /* helper_stats_h */
@@ -0,0 +1,112 @@
+//
+//  helper_trace.cpp
+//  VulkanTesting
+//
+//  CPU trace zones, written out in the Chrome trace format (chrome://tracing, ui.perfetto.dev).
+//
+#include "helper_trace.h"
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+struct TraceEvent {
+    std::string name;
+    int64_t startMicroseconds;
+    int64_t durationMicroseconds;
+    uint32_t threadIndex;
+};
+
+static std::atomic<bool> traceActive{false};
+static std::chrono::steady_clock::time_point traceEpoch; // timestamps are relative to enableTracing()
+// Zones only close a handful of times per stage, a lock is cheaper than being clever here
+static std::mutex traceMutex;
+static std::vector<TraceEvent> traceEvents;
+static std::vector<std::thread::id> traceThreads; // index in here is the "tid" in the trace, small numbers read better than hashes
+
+void enableTracing() {
+    std::lock_guard<std::mutex> lock(traceMutex);
+    traceEpoch = std::chrono::steady_clock::now();
+    traceEvents.clear();
+    traceActive = true;
+}
+
+bool tracingEnabled() {
+    return traceActive;
+}
+
+static uint32_t threadIndex(std::thread::id thread) {
+    for (size_t i = 0; i < traceThreads.size(); i++) {
+        if (traceThreads[i] == thread) {
+            return static_cast<uint32_t>(i);
+        }
+    }
+    traceThreads.push_back(thread);
+    return static_cast<uint32_t>(traceThreads.size() - 1);
+}
+
+static void writeJsonString(std::ostream& out, const std::string& value) {
+    out << '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            out << ' ';
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+void writeTrace(const std::string& path) {
+    std::lock_guard<std::mutex> lock(traceMutex);
+    traceActive = false;
+
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        throw std::runtime_error("Failed to open trace file " + path);
+    }
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << std::endl;
+    for (size_t i = 0; i < traceEvents.size(); i++) {
+        const TraceEvent& event = traceEvents[i];
+        out << "  {\"name\": ";
+        writeJsonString(out, event.name);
+        out << ", \"cat\": \"cpu\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << event.threadIndex
+            << ", \"ts\": " << event.startMicroseconds << ", \"dur\": " << event.durationMicroseconds << "}"
+            << (i + 1 < traceEvents.size() ? "," : "") << std::endl;
+    }
+    out << "]}" << std::endl;
+    traceEvents.clear();
+
+    if (!out) {
+        throw std::runtime_error("Failed to write trace file " + path);
+    }
+}
+
+TraceZone::TraceZone(const char* name) : TraceZone(std::string(name)) {
+}
+
+TraceZone::TraceZone(const std::string& name) : active(traceActive) {
+    if (active) {
+        this->name = name;
+        start = std::chrono::steady_clock::now();
+    }
+}
+
+TraceZone::~TraceZone() {
+    if (!active) return;
+    auto end = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock(traceMutex);
+    if (!traceActive) return; // the trace was written while we were open
+    TraceEvent event;
+    event.name = std::move(name);
+    event.startMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(start - traceEpoch).count();
+    event.durationMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    event.threadIndex = threadIndex(std::this_thread::get_id());
+    traceEvents.push_back(std::move(event));
+}
@@ -0,0 +1,34 @@
+//
+//  helper_trace.h
+//  VulkanTesting
+//
+//  CPU trace zones, written out in the Chrome trace format (chrome://tracing, ui.perfetto.dev).
+//
+
+#ifndef helper_trace_h
+#define helper_trace_h
+#include <chrono>
+#include <string>
+
+// Tracing is off until enableTracing() is called. While it's off a TraceZone costs a flag check, so zones can stay in the code
+void enableTracing();
+bool tracingEnabled();
+// Writes everything recorded so far and stops recording, so zones hit later (e.g. on swapchain recreation) don't pile up
+void writeTrace(const std::string& path);
+
+// Records the time between its construction and destruction as one complete ("X") event on the calling thread
+class TraceZone {
+    public:
+    explicit TraceZone(const char* name);
+    explicit TraceZone(const std::string& name);
+    ~TraceZone();
+    TraceZone(const TraceZone&) = delete;
+    TraceZone& operator=(const TraceZone&) = delete;
+
+    private:
+    std::string name;
+    bool active;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif /* helper_trace_h */
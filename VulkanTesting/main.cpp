@@ -6,10 +6,35 @@
 #include <cstdlib>
 #include <vector>
 #include <optional> //requires c++17
-#include <set>
 #include <cstdint>
 #include <fstream>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
 #include "helper_extensions.h"
+#include "helper_options.h"
+#include "helper_stats.h"
+#include "helper_spsc_queue.h"
+#include "helper_frame_limiter.h"
+#include "helper_benchmark.h"
+#include "helper_gpu_profiler.h"
+#include "helper_trace.h"
+#include "helper_capabilities.h"
+#include "helper_logger.h"
+#include "helper_allocator.h"
+#include "helper_memory_budget.h"
+#include "helper_hud.h"
+#include "helper_baseline.h"
+#include "helper_device_selection.h"
+#include "helper_queues.h"
+#include "helper_dispatch.h"
+#include "helper_features.h"
+#include "helper_present_wait.h"
 
 const int WIDTH = 800;
 const int HEIGHT = 600;
@@ -21,54 +46,212 @@ const std::vector<const char*> validationLayers = {
     "VK_LAYER_KHRONOS_validation"
 };
 
-// Here we list the device extensions we require
-const std::vector<const char*> deviceExtensions {
+// The device extensions we require unless we run headless. Everything else, timeline semaphores included, is in the optional feature
+// table (helper_features.cpp): core in newer versions, extensions on older ones. isDeviceSuitable insists on the timeline either way
+const std::vector<const char*> swapChainExtensions {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME // Not all devices can present. Thus, swapchains are an extension provided by the device
 };
 
-// If not in debug mode, don't enable the validation layers
-#ifdef NDEBUG
-    const bool enableValidationLayers = false;
-#else
-    const bool enableValidationLayers = true;
-#endif
+// Nice to have: these let us see when a present actually reaches the display, see presentWaitEnabled
+const std::vector<const char*> presentWaitExtensions {
+    VK_KHR_PRESENT_ID_EXTENSION_NAME,
+    VK_KHR_PRESENT_WAIT_EXTENSION_NAME
+};
+
+// What the performance validation profile turns on and off, through VK_EXT_validation_features.
+// Best practices flags things that are legal but slow; everything that checks correctness is switched off, so it costs a lot less than full validation
+const std::vector<VkValidationFeatureEnableEXT> performanceValidationEnables = {
+    VK_VALIDATION_FEATURE_ENABLE_BEST_PRACTICES_EXT
+};
+const std::vector<VkValidationFeatureDisableEXT> performanceValidationDisables = {
+    VK_VALIDATION_FEATURE_DISABLE_CORE_CHECKS_EXT,
+    VK_VALIDATION_FEATURE_DISABLE_SHADERS_EXT,
+    VK_VALIDATION_FEATURE_DISABLE_API_PARAMETERS_EXT,
+    VK_VALIDATION_FEATURE_DISABLE_OBJECT_LIFETIMES_EXT,
+    VK_VALIDATION_FEATURE_DISABLE_THREAD_SAFETY_EXT
+};
 
 class HelloTriangleApplication {
 
     public:
+    HelloTriangleApplication(const AppOptions& options) : options(options), frameLimiter(options.targetFrameSeconds), benchmark(options.warmupFrames, options.benchmarkFrames), presentPolicy(options.presentPolicy) {}
+    
     void run() {
-        initWindow();
-        initVulkan();
+        if (!options.tracePath.empty()) {
+            enableTracing();
+        }
+        if (options.trackHostAllocations) {
+            hostAllocations.enable(options.poolHostAllocations); // before the instance, everything has to be created and destroyed with the same callbacks
+        }
+        auto startupStart = std::chrono::steady_clock::now();
+        {
+            TraceZone zone("startup"); // everything until we're ready to draw the first frame
+            if (!options.headless) {
+                initWindow();
+            }
+            initVulkan();
+        }
+        benchmark.setDrawsPerFrame(options.drawsPerFrame);
+        benchmark.setStartupMilliseconds(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupStart).count());
+        if (tracingEnabled()) {
+            writeTrace(options.tracePath);
+            std::cout << "Startup trace written to " << options.tracePath << std::endl;
+        }
         mainLoop();
         cleanup();
+        // Only now, so a regression still exits cleanly. main turns this into a failing exit code
+        if (performanceRegressed) {
+            throw std::runtime_error("Performance regressed against the baseline " + options.baselinePath);
+        }
     }
         
     private:
-    GLFWwindow* window; // GFLW manages windowing. This is a pointer to our window
+    AppOptions options;
+    GLFWwindow* window = nullptr; // GFLW manages windowing. This is a pointer to our window
     VkInstance instance; // The instance connects the app and the Vulkan library
     VkDebugUtilsMessengerEXT debugMessenger; // A callback for debugging purposes
-    VkSurfaceKHR surface; // A surface is where images actually get rendered to. It is an abstract representation that will be backed by whatever windowing system we're using (GLFW in our case)
+    ValidationLogger validationLogger; // where debugCallback sends messages, written out on the logger's own thread
+    HostAllocationTracker hostAllocations; // the driver's host memory, per kind of object (--host-alloc)
+    MemoryBudgetMonitor memoryBudget; // GPU memory per heap against its budget, sampled every frame when VK_EXT_memory_budget is there
+    VkSurfaceKHR surface = VK_NULL_HANDLE; // A surface is where images actually get rendered to. It is an abstract representation that will be backed by whatever windowing system we're using (GLFW in our case)
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE; // handle to the phyisical device
+    InstanceCapabilities instanceCapabilities; // queried once in initVulkan, read-only after that
+    DeviceCapabilities physicalDeviceCapabilities; // same, for the chosen device
+    uint32_t instanceApiVersion = VK_API_VERSION_1_0; // what we created the instance with, negotiated in createInstance
+    OptionalFeatures enabledFeatures; // what the logical device was created with. Fast paths branch on these
+    bool deviceUUIDsAvailable = false; // VK_KHR_external_memory_capabilities is enabled, so we can ask for VkPhysicalDeviceIDProperties
+    bool surfaceMaintenanceAvailable = false; // VK_EXT_surface_maintenance1 is enabled, which VK_EXT_swapchain_maintenance1 needs on the instance
     VkDevice device; // This will be the logical device
     VkQueue graphicsQueue; // Queues are created along the logical device but we need somewhere to store a handler to them
     VkQueue presentQueue; // Queues are created along the logical device but we need somewhere to store a handler to them
-    VkSwapchainKHR swapChain;
-    std::vector<VkImage> swapChainImages;
+    VkQueue computeQueue; // async compute. May be graphicsQueue itself, see queuePlan
+    VkQueue transferQueue; // uploads and readbacks. May be computeQueue or graphicsQueue, see queuePlan
+    QueuePlan queuePlan; // which family and index each of the queues above is, and whether it has a queue of its own
+    VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+    std::vector<VkImage> swapChainImages; // headless: our own offscreen images, see createOffscreenImages
+    std::vector<VkDeviceMemory> offscreenImageMemory; // headless only, the memory behind swapChainImages
     VkFormat swapChainImageFormat;
     VkExtent2D swapChainExtent;
+    VkPresentModeKHR swapChainPresentMode;
     std::vector<VkImageView> swapChainImageViews; // they describe how to access images and which parts of them to access
     VkRenderPass renderPass;
     VkPipelineLayout pipelineLayout; // used to change behaviour of shaders after pipeline is created
     VkPipeline graphicsPipeline;
+    VkPipelineLayout hudPipelineLayout; // the overlay's, see createHudPipeline
+    VkPipeline hudPipeline;
     std::vector<VkFramebuffer> swapChainFramebuffers; // Binds the attachments for input to the renderPass
     VkCommandPool commandPool; // a commandPool manages memory to store command buffers
     std::vector<VkCommandBuffer> commandBuffers;
-    VkSemaphore imageAvailableSemaphore; // to signal that an image has been aquired from the chain and ready to be rendered to
-    VkSemaphore renderFinishedSemaphore; // to signal that the image has finished rederering and can be presented
+    
+    // Resizing replaces the swapchain and everything sized after it. The old objects may still be used by frames in flight,
+    // so instead of stalling with vkDeviceWaitIdle we park them here until the timeline says the GPU is done with them.
+    // The swapchain itself also has to wait for the presentation engine, which the timeline knows nothing about, see destroyRetiredSwapChains.
+    // Nothing here ever blocks: a drag-resize recreates the swapchain nearly every frame
+    struct RetiredSwapChain {
+        VkSwapchainKHR swapChain;
+        std::vector<VkImageView> imageViews;
+        std::vector<VkFramebuffer> framebuffers;
+        std::vector<VkCommandBuffer> commandBuffers;
+        std::vector<VkQueryPool> queryPools; // the GPU profiler's, written by commandBuffers
+        HudOverlay::Buffers hudBuffers; // the overlay's vertices, read by commandBuffers
+        uint64_t retireAfterFrame; // the GPU is done with it once graphicsTimeline reaches this value
+        uint64_t lastPresent; // presentsQueued when it was retired. Anything after that went to a newer swapchain
+    };
+    std::deque<RetiredSwapChain> retiredSwapChains;
+    uint64_t presentsQueued = 0; // presents vkQueuePresentKHR accepted, always on the current swapchain
+    
+    // With VK_EXT_swapchain_maintenance1 a present can carry a fence the presentation engine signals once it is done with it.
+    // The first present on a new swapchain gets one, and the swapchains retired before it are destroyed once it signals
+    bool presentFencesEnabled = false;
+    struct PresentFence {
+        VkFence fence;
+        uint64_t present; // presentsQueued right after the fenced present
+    };
+    std::deque<PresentFence> presentFences; // in flight, oldest first
+    std::vector<VkFence> freePresentFences; // signaled and reset, ready to go on another present
+    std::vector<VkFence> rejectedPresentFences; // their present failed, so they may never signal. Destroyed with the device
+    uint64_t lastFencedPresent = 0; // presentsQueued right after the newest present that got a fence
+    uint64_t completedFencedPresent = 0; // same, for the newest one whose fence has signaled
+    bool framebufferResized = false; // set when a resize event comes in
+    int framebufferWidth = 0, framebufferHeight = 0; // latest size reported by GLFW, in pixels
+    bool swapChainOutOfDate = false; // the swapchain no longer matches the surface and must be recreated before the next frame
+    bool windowMinimized = false; // a zero sized framebuffer can't have a swapchain, so we just don't draw
+    bool needsRedraw = true; // on-demand mode: something changed since the last frame we presented
+    std::chrono::steady_clock::time_point lastRedrawTime;
+    
+    // GLFW callbacks run on the main thread, while frames may be rendered on another one (--render-thread).
+    // Callbacks never touch renderer state directly: they post events here and the renderer applies them at the start of a frame.
+    // With a single thread the same thread is both producer and consumer, which the queue handles just as well
+    struct InputEvent {
+        enum Type { FramebufferResized, Key, Changed } type; // Changed: anything else that needs a redraw (mouse, focus, exposure...)
+        int width = 0, height = 0; // FramebufferResized
+        int key = 0, action = 0; // Key
+        std::chrono::steady_clock::time_point time; // when the callback got it, stamped by postInputEvent
+    };
+    SpscQueue<InputEvent, 1024> inputEvents;
+    std::atomic<bool> renderThreadRunning{false};
+    std::mutex renderWakeMutex; // only used to sleep the idle render thread, never on the event path itself
+    std::condition_variable renderWake;
+    std::exception_ptr renderThreadError;
+    
+    FrameLimiter frameLimiter;
+    BenchmarkRecorder benchmark; // only records with --benchmark
+    bool performanceRegressed = false; // the benchmark came out worse than --baseline
+    GpuProfiler gpuProfiler;
+    GpuProfiler::ScopeId renderPassScope = 0;
+    GpuProfiler::ScopeId hudScope = 0;
+    bool pipelineStatisticsEnabled = false; // the device supports (and we enabled) pipelineStatisticsQuery
+    HudOverlay hud; // performance overlay, --hud or F1
+    std::chrono::steady_clock::time_point lastFrameStart; // for the overlay's frame time graph
+    double lastFrameCpuMilliseconds = 0.0;
+    
+    // Present policy measurements. Latency is from the start of a frame's CPU work until we see the GPU finished it
+    PresentPolicy presentPolicy; // the policy the current swapchain was built with. Changes during a --present-sweep
+    std::deque<std::pair<uint64_t, std::chrono::steady_clock::time_point>> pendingFrameStarts; // frame number and when its CPU work began
+    SampleStats frameLatencies; // milliseconds
+    std::chrono::steady_clock::time_point policyStart;
+    uint64_t policyFrames = 0;
+    // The swapchain only understands binary semaphores, so acquire and present still need one pair per frame in flight
+    std::vector<VkSemaphore> imageAvailableSemaphores; // to signal that an image has been aquired from the chain and ready to be rendered to
+    std::vector<VkSemaphore> renderFinishedSemaphores; // to signal that the image has finished rederering and can be presented
+    
+    // A timeline semaphore holds a 64 bit counter instead of a signaled/unsignaled flag. Every submission to the queue signals the next value,
+    // so "has frame N finished?" becomes "is the counter >= N?". That single number replaces one fence per frame and the resets they need
+    struct QueueTimeline {
+        VkQueue queue = VK_NULL_HANDLE;
+        VkSemaphore semaphore = VK_NULL_HANDLE;
+        uint64_t submitted = 0; // value the most recent submission will signal
+        uint64_t completed = 0; // last value we saw the GPU reach
+    };
+    QueueTimeline graphicsTimeline;
+    uint64_t frameNumber = 0; // the frame being built. Frame N signals value N on graphicsTimeline
+    std::vector<uint64_t> imageFrameNumbers; // the frame that last rendered to each swapchain image, 0 if none
+    uint64_t framesRendered = 0;
+    std::chrono::duration<double> frameWaitTime{0}; // total time the CPU spent blocked because the GPU was maxFramesInFlight frames behind
+    
+    // The device functions we call every frame (and the extension ones the loader doesn't export), looked up once in createLogicalDevice
+    DeviceDispatch dispatch;
+    
+    // With VK_KHR_present_id every present is tagged with its frame number, and VK_KHR_present_wait lets us block until a given
+    // one is on screen. That is the only way to know when a frame was really displayed rather than guessing from vsync
+    bool presentWaitEnabled = false;
+    PresentWaiter presentWaiter; // only used from the thread that draws, see waitForNextFrame. Present ids == frame numbers
+    std::vector<PresentWaiter::Presented> presentedFrames; // reused every frame by collectPresentedFrames
+    std::optional<std::chrono::steady_clock::time_point> unshownInputTime; // the oldest input event no presented frame has reacted to yet
+    std::chrono::steady_clock::time_point lastInputTime; // what the frame being drawn reacts to: unshownInputTime, or when it sampled the state
+    bool lastInputFromEvent = false; // whether lastInputTime is an input event's
+    struct PhotonLatencies {
+        SampleStats milliseconds;
+        uint64_t exact = 0; // how many have an exact display time, the others are upper bounds
+    };
+    PhotonLatencies inputToPhoton; // from the input event a frame reacted to until it was on screen
+    PhotonLatencies sampleToPhoton; // frames without new input: from when the frame sampled its state. Not a latency anyone felt
     
     struct QueueFamilyIndices {
         std::optional<uint32_t> graphicsFamily; // Drawing
         std::optional<uint32_t> presentFamily; // Presenting to surfaces
+        std::optional<uint32_t> computeFamily; // Compute but no graphics: async compute, only if the device has such a family
+        std::optional<uint32_t> transferFamily; // Transfer only: usually the DMA/copy engine, only if the device has such a family
         
         bool isComplete() {
             return graphicsFamily.has_value() && presentFamily.has_value();
@@ -77,49 +260,98 @@ class HelloTriangleApplication {
     
     struct SwapChainSupportDetails {
         VkSurfaceCapabilitiesKHR capabilities; // max/min number of images, max/min witdh and height of images
-        std::vector<VkSurfaceFormatKHR> formats; // pixel format and color space
-        std::vector<VkPresentModeKHR> presentModes; // available presentation modes -- like double buffering, triple buffering...
+        const std::vector<VkSurfaceFormatKHR>& formats; // pixel format and color space
+        const std::vector<VkPresentModeKHR>& presentModes; // available presentation modes -- like double buffering, triple buffering...
     };
     
+    // What each device can do with our surface. Device selection, device creation, the command pool and every swapchain (re)creation
+    // all ask, and the answers only change if the surface does, so they're queried once per device and surface and kept here.
+    // The exception is the surface capabilities: currentExtent follows the window size, so querySwapChainSupport always asks for those
+    struct DeviceSurfaceInfo {
+        VkSurfaceKHR surface = VK_NULL_HANDLE; // the surface this was queried for, a different one starts over
+        std::optional<QueueFamilyIndices> queueFamilies;
+        bool swapChainQueried = false;
+        std::vector<VkSurfaceFormatKHR> formats;
+        std::vector<VkPresentModeKHR> presentModes;
+    };
+    std::map<VkPhysicalDevice, DeviceSurfaceInfo> deviceSurfaceInfo;
+    
+    DeviceSurfaceInfo& surfaceInfo(VkPhysicalDevice device) {
+        DeviceSurfaceInfo& info = deviceSurfaceInfo[device];
+        if (info.surface != surface) {
+            info = DeviceSurfaceInfo();
+            info.surface = surface;
+        }
+        return info;
+    }
+    
     void initVulkan() {
-        printVulkanSupportedExtensions();
-        printGlfwRequiredExtensions();
-        checkGlfwRequiredExtensionsAvailable();
+        {
+            TraceZone zone("queryInstanceCapabilities");
+            // the only time we enumerate instance extensions and layers. The validation layer's own extensions are only needed if we'll use it
+            instanceCapabilities = queryInstanceCapabilities(validationEnabled() ? validationLayers : std::vector<const char*>());
+        }
+        if (options.verbose) {
+            printVulkanSupportedExtensions(instanceCapabilities.extensions);
+            if (!options.headless) {
+                printGlfwRequiredExtensions();
+            }
+        }
+        if (!options.headless && !checkGlfwRequiredExtensionsAvailable(instanceCapabilities.extensions)) {
+            throw std::runtime_error("This Vulkan installation lacks instance extensions GLFW needs to create a surface");
+        }
         createInstance();
         setupDebugMessenger();
-        createSurface();
+        if (!options.headless) {
+            createSurface();
+        }
         pickPhysicalDevice();
         createLogicalDevice();
-        createSwapChain();
+        if (options.headless) {
+            createOffscreenImages(); // stands in for the swapchain, everything after this doesn't know the difference
+        } else {
+            createSwapChain();
+        }
         createImageViews();
         createRenderPass();
         createGraphicsPipeline();
+        createHudPipeline();
         createFramebuffers();
         createCommandPool();
+        createGpuProfiler();
+        createHud();
         createCommandBuffers();
         createSemaphores();
     }
     
     SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device) {
-        SwapChainSupportDetails details;
-        
-        vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &details.capabilities);
+        const DeviceSurfaceInfo& info = querySurfaceFormats(device);
+        VkSurfaceCapabilitiesKHR capabilities;
+        vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &capabilities);
+        return {capabilities, info.formats, info.presentModes};
+    }
+    
+    // Formats and present modes, from the driver the first time and from deviceSurfaceInfo after that
+    const DeviceSurfaceInfo& querySurfaceFormats(VkPhysicalDevice device) {
+        DeviceSurfaceInfo& info = surfaceInfo(device);
+        if (info.swapChainQueried) return info;
         
         uint32_t formatCount;
         vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, nullptr);
         if (formatCount !=0) {
-            details.formats.resize(formatCount); // properly allocate the vector
-            vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, details.formats.data());
+            info.formats.resize(formatCount); // properly allocate the vector
+            vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, info.formats.data());
         }
         
         uint32_t presentModeCount;
         vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, nullptr);
         if (presentModeCount != 0) {
-            details.presentModes.resize(presentModeCount); // properly allocate the vector
-            vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, details.presentModes.data());
+            info.presentModes.resize(presentModeCount); // properly allocate the vector
+            vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, info.presentModes.data());
         }
         
-        return details;
+        info.swapChainQueried = true;
+        return info;
     }
     
     VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats) {
@@ -135,7 +367,7 @@ class HelloTriangleApplication {
         return availableFormats[0];
     }
     
-    VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
+    VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes, PresentPolicy policy) {
         /* Four modes are available:
          - VK_PRESENT_MODE_IMMEDIATE_KHR: Images sent right away to the screen, which may result in tearing.
          - VK_PRESENT_MODE_FIFO_KHR: Queue mode, where the display takes an image from the front of the queue on refresh while the app pushes images to the back. App has to wait if queue is full. Similar to VSYNC.
@@ -143,12 +375,30 @@ class HelloTriangleApplication {
          - VK_PRESENT_MODE_MAILBOX_KHR: Like FIFO but discard images from the queue if the queue is full when the app submits a new one. This discards frames in that case. Similar to triple buffering.
          
          Only VK_PRESENT_MODE_FIFO_KHR is guaranteed to be available.
+         
+         Which one is best depends on what we want, so each policy lists its modes from most to least preferred
          */
+        std::vector<VkPresentModeKHR> preferred;
+        switch (policy) {
+            case PresentPolicy::LowLatency:
+                // Newest frame wins and no tearing. Immediate has even less latency, but tears
+                preferred = {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR};
+                break;
+            case PresentPolicy::MaxThroughput:
+                // Never block on the display
+                preferred = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR};
+                break;
+            case PresentPolicy::PowerSaving:
+                // Render at most at the refresh rate. Relaxed avoids a full extra refresh of stutter when we're a bit late
+                preferred = {VK_PRESENT_MODE_FIFO_RELAXED_KHR};
+                break;
+        }
         
-        for (const auto& availablePresentMode : availablePresentModes) {
-            // Should we have triple buffer, use it
-            if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-                return availablePresentMode;
+        for (VkPresentModeKHR mode : preferred) {
+            for (const auto& availablePresentMode : availablePresentModes) {
+                if (availablePresentMode == mode) {
+                    return availablePresentMode;
+                }
             }
         }
         
@@ -156,6 +406,36 @@ class HelloTriangleApplication {
         return VK_PRESENT_MODE_FIFO_KHR;
     }
     
+    uint32_t chooseSwapImageCount(const VkSurfaceCapabilitiesKHR& capabilities, VkPresentModeKHR presentMode, PresentPolicy policy) {
+        // theres a min and max number of images on the swap chain, it varies by implementation
+        uint32_t imageCount = capabilities.minImageCount;
+        
+        if (presentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
+            // Mailbox needs one image on screen, one waiting and one to render to, or it degrades to FIFO
+            imageCount = std::max(imageCount + 1, 3u);
+        } else if (policy == PresentPolicy::MaxThroughput) {
+            // An extra image so the GPU always has something to render to while the others are being presented
+            imageCount = imageCount + 1;
+        }
+        // else, FIFO modes: every extra image is one more frame queued in front of the display, i.e. more latency and more power. Stay at the minimum
+        
+        // there's a special value 0 for the max which means "no max". Either way, let's try not to get over the max if there's any
+        if (capabilities.maxImageCount > 0 && imageCount > capabilities.maxImageCount) {
+            imageCount = capabilities.maxImageCount;
+        }
+        return imageCount;
+    }
+    
+    static const char* presentModeName(VkPresentModeKHR mode) {
+        switch (mode) {
+            case VK_PRESENT_MODE_IMMEDIATE_KHR: return "IMMEDIATE";
+            case VK_PRESENT_MODE_MAILBOX_KHR: return "MAILBOX";
+            case VK_PRESENT_MODE_FIFO_KHR: return "FIFO";
+            case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "FIFO_RELAXED";
+            default: return "other";
+        }
+    }
+    
     VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities) {
         // This is the resolution of the images in the swap chain. Should be equal to the resolution of the window.
         // The ranges avaiable are in VkSurfaceCapabilitiesKHR.currentExtent.
@@ -165,8 +445,8 @@ class HelloTriangleApplication {
             // if the current extent has no special value, use it because it's automatched
             return capabilities.currentExtent;
         } else {
-            // use the dimensions we defined for the window within the min/max bounds
-            VkExtent2D actualExtent = {WIDTH, HEIGHT};
+            // use the size of the window's framebuffer (in pixels, which may differ from screen coordinates on high DPI displays) within the min/max bounds
+            VkExtent2D actualExtent = {static_cast<uint32_t>(framebufferWidth), static_cast<uint32_t>(framebufferHeight)};
             actualExtent.width = std::max(capabilities.minImageExtent.width,
                                           std::min(capabilities.maxImageExtent.width,
                                                    actualExtent.width));
@@ -177,8 +457,11 @@ class HelloTriangleApplication {
         }
     }
     
-    static std::vector<char> readFile(const std::string& filename) {
-        std::cout << "Loading " << filename << std::endl;
+    std::vector<char> readFile(const std::string& filename) {
+        TraceZone zone("readFile " + filename);
+        if (options.verbose) {
+            std::cout << "Loading " << filename << std::endl;
+        }
         // ate: read at the end, so the read position determines file size; binary: avoid text transformations
         std::ifstream file(filename, std::ios::ate | std::ios::binary);
         
@@ -198,18 +481,61 @@ class HelloTriangleApplication {
     }
     
     void createSemaphores() {
+        TraceZone zone(__func__);
+        imageAvailableSemaphores.resize(options.maxFramesInFlight);
+        renderFinishedSemaphores.resize(options.maxFramesInFlight);
+        imageFrameNumbers.resize(swapChainImages.size(), 0); // no image is in use yet
+        
         // it does not take much...
         VkSemaphoreCreateInfo semaphoreInfo = {};
         semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
         
-        if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphore) != VK_SUCCESS
-            ||
-            vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphore) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to create semaphores");
+        for (size_t i = 0; i < options.maxFramesInFlight; i++) {
+            if (vkCreateSemaphore(device, &semaphoreInfo, allocator(HostAllocationObject::Semaphore), &imageAvailableSemaphores[i]) != VK_SUCCESS
+                ||
+                vkCreateSemaphore(device, &semaphoreInfo, allocator(HostAllocationObject::Semaphore), &renderFinishedSemaphores[i]) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create semaphores");
+            }
+        }
+        
+        // The timeline semaphore is the same call with a VkSemaphoreTypeCreateInfo chained in
+        VkSemaphoreTypeCreateInfoKHR timelineInfo = {};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+        timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+        timelineInfo.initialValue = 0; // frame 0 is "nothing submitted yet", so it is already complete
+        semaphoreInfo.pNext = &timelineInfo;
+        
+        graphicsTimeline.queue = graphicsQueue;
+        if (vkCreateSemaphore(device, &semaphoreInfo, allocator(HostAllocationObject::Semaphore), &graphicsTimeline.semaphore) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create timeline semaphore");
         }
     }
     
+    // Reads the GPU's progress without blocking. Anything tagged with a frame number <= the result can be reused or destroyed
+    uint64_t pollCompletedFrame(QueueTimeline& timeline) {
+        if (dispatch.vkGetSemaphoreCounterValueKHR(device, timeline.semaphore, &timeline.completed) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to read timeline semaphore value");
+        }
+        return timeline.completed;
+    }
+    
+    // Blocks until the GPU has finished the given frame
+    void waitForFrame(QueueTimeline& timeline, uint64_t value) {
+        if (value <= timeline.completed) return; // already known to be done, no need to ask the driver
+        
+        VkSemaphoreWaitInfoKHR waitInfo = {};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &timeline.semaphore;
+        waitInfo.pValues = &value;
+        if (dispatch.vkWaitSemaphoresKHR(device, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to wait on timeline semaphore");
+        }
+        timeline.completed = value;
+    }
+    
     void createCommandBuffers() {
+        TraceZone zone(__func__);
         commandBuffers.resize(swapChainFramebuffers.size());
         VkCommandBufferAllocateInfo allocInfo = {};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -224,59 +550,171 @@ class HelloTriangleApplication {
         if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
             throw std::runtime_error("Failed to allocate command buffers");
         }
+        gpuProfiler.createPools(static_cast<uint32_t>(commandBuffers.size())); // each command buffer writes its own timestamps
+        hud.createBuffers(static_cast<uint32_t>(commandBuffers.size())); // and draws its own overlay vertices
         
         for (size_t i = 0; i < commandBuffers.size(); i++) {
             VkCommandBufferBeginInfo beginInfo = {};
             beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
             
-            if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS) {
+            if (dispatch.vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS) {
                 throw std::runtime_error("Failed to begin recording a command buffer");
             }
             
             // now we start recording the commands. Methods that start with vkCmd are commands being recorded.
-            // we have to begin the render pass first thing:
-            
-            VkRenderPassBeginInfo renderPassInfo = {};
-            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-            renderPassInfo.renderPass = renderPass;
-            renderPassInfo.framebuffer = swapChainFramebuffers[i];
-            renderPassInfo.renderArea.offset = {0, 0};
-            renderPassInfo.renderArea.extent = swapChainExtent;
-            // what to clear to when vk_attachment_load_op_clear. Black it is:
-            VkClearValue clearColor = {0.0f, 0.0f, 0.0f, 1.0f};
-            renderPassInfo.clearValueCount = 1;
-            renderPassInfo.pClearValues = &clearColor;
-            
-            // final paramete tells if the commands will execute on secondary command buffers (VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS) or not (VK_SUBPASS_CONTENTS_INLINE)
-            vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-            vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+            // Timestamp queries are reset before anything writes them, and that can't happen inside a render pass
+            gpuProfiler.reset(commandBuffers[i], static_cast<uint32_t>(i));
             
-            // finally, we are DRAWING THE TRIANGLE.
-            vkCmdDraw(commandBuffers[i], 3, 1, 0, 0);
+            {
+                // Everything until the end of this block is timed on the GPU as "render_pass", and its pipeline statistics counted
+                GpuProfiler::Zone renderPassZone(gpuProfiler, commandBuffers[i], static_cast<uint32_t>(i), renderPassScope);
+                
+                // we have to begin the render pass first thing:
+                VkRenderPassBeginInfo renderPassInfo = {};
+                renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+                renderPassInfo.renderPass = renderPass;
+                renderPassInfo.framebuffer = swapChainFramebuffers[i];
+                renderPassInfo.renderArea.offset = {0, 0};
+                renderPassInfo.renderArea.extent = swapChainExtent;
+                // what to clear to when vk_attachment_load_op_clear. Black it is:
+                VkClearValue clearColor = {0.0f, 0.0f, 0.0f, 1.0f};
+                renderPassInfo.clearValueCount = 1;
+                renderPassInfo.pClearValues = &clearColor;
+                
+                // final paramete tells if the commands will execute on secondary command buffers (VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS) or not (VK_SUBPASS_CONTENTS_INLINE)
+                dispatch.vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+                dispatch.vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+                
+                // viewport and scissor are dynamic state (see createGraphicsPipeline), so they follow the swapchain without rebuilding the pipeline
+                VkViewport viewport = {0.0f, 0.0f, (float) swapChainExtent.width, (float) swapChainExtent.height, 0.0f, 1.0f};
+                VkRect2D scissor = {{0, 0}, swapChainExtent};
+                dispatch.vkCmdSetViewport(commandBuffers[i], 0, 1, &viewport);
+                dispatch.vkCmdSetScissor(commandBuffers[i], 0, 1, &scissor);
+                
+                // finally, we are DRAWING THE TRIANGLE. More than once with --draws, to load the driver with draw calls
+                for (uint32_t draw = 0; draw < options.drawsPerFrame; draw++) {
+                    dispatch.vkCmdDraw(commandBuffers[i], 3, 1, 0, 0);
+                }
+                
+                {
+                    // The overlay goes on top, in the same render pass: a pass of its own would load and store the whole image again for a few quads.
+                    // It's always recorded, what (if anything) it draws is decided every frame in updateHud. Timed separately to keep an eye on its cost
+                    GpuProfiler::Zone hudZone(gpuProfiler, commandBuffers[i], static_cast<uint32_t>(i), hudScope);
+                    dispatch.vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, hudPipeline); // viewport and scissor carry over, they're dynamic in both pipelines
+                    hud.record(commandBuffers[i], static_cast<uint32_t>(i));
+                }
+                
+                dispatch.vkCmdEndRenderPass(commandBuffers[i]);
+            }
             
             // finish recording
-            vkCmdEndRenderPass(commandBuffers[i]);
-            if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS) {
+            if (dispatch.vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS) {
                 throw std::runtime_error("failed to record a command buffer");
             }
         }
         
     }
     
+    void createGpuProfiler() {
+        TraceZone zone(__func__);
+        QueueFamilyIndices indices = findQueueFamilies(physicalDeviceCapabilities);
+        const VkQueueFamilyProperties& graphicsFamily = physicalDeviceCapabilities.queueFamilies[indices.graphicsFamily.value()];
+        gpuProfiler.init(device, physicalDeviceCapabilities.properties.limits.timestampPeriod, graphicsFamily.timestampValidBits, pipelineStatisticsEnabled,
+                         dispatch, allocator(HostAllocationObject::QueryPool));
+        if (options.verbose) {
+            if (!gpuProfiler.hasTimings()) {
+                std::cout << "GPU timestamps not supported on this queue, GPU timings disabled" << std::endl;
+            }
+            if (!gpuProfiler.hasStatistics()) {
+                std::cout << "Pipeline statistics queries not supported, GPU counters disabled" << std::endl;
+            }
+        }
+        renderPassScope = gpuProfiler.addScope("render_pass", true);
+        hudScope = gpuProfiler.addScope("hud"); // inside render_pass, so render_pass includes it
+    }
+    
+    void createHud() {
+        TraceZone zone(__func__);
+        hud.init(device, dispatch, physicalDeviceCapabilities.memoryProperties, hostAllocations, options.hud);
+    }
+    
+    // Fills in the overlay for the frame about to use this image. Its previous frame must be done, since we overwrite what it drew
+    void updateHud(uint32_t imageIndex, std::chrono::steady_clock::time_point frameStart) {
+        // The graph keeps going while hidden, so it's already full when the overlay is shown
+        if (lastFrameStart != std::chrono::steady_clock::time_point()) {
+            hud.addFrameTime(std::chrono::duration<double, std::milli>(frameStart - lastFrameStart).count());
+        }
+        lastFrameStart = frameStart;
+        if (!hud.visible()) {
+            hud.update(imageIndex, swapChainExtent, HudStats()); // only zeroes the draw's vertex count
+            return;
+        }
+        
+        HudStats stats;
+        stats.cpuMilliseconds = lastFrameCpuMilliseconds;
+        stats.hasGpuTime = gpuProfiler.hasTimings();
+        if (stats.hasGpuTime) {
+            stats.gpuMilliseconds = gpuProfiler.lastMilliseconds(renderPassScope);
+            stats.hudMilliseconds = gpuProfiler.lastMilliseconds(hudScope);
+        }
+        // Video memory is the first device local heap. Its numbers are from the last sample, a frame old at most
+        for (size_t i = 0; i < memoryBudget.heapCount(); i++) {
+            if (!memoryBudget.deviceLocal(i)) continue;
+            stats.hasMemory = true;
+            stats.memoryUsedMiB = memoryBudget.usage(i) / (1024.0 * 1024.0);
+            stats.memoryBudgetMiB = memoryBudget.budget(i) / (1024.0 * 1024.0);
+            break;
+        }
+        hud.update(imageIndex, swapChainExtent, stats);
+    }
+    
+    // Reads the GPU timings and counters of the frame that last used this image. Call only once that frame is known to be complete
+    void collectGpuTimes(uint32_t imageIndex) {
+        if (!gpuProfiler.collect(imageIndex)) return;
+        uint64_t frame = gpuProfiler.lastFrame();
+        for (GpuProfiler::ScopeId scope = 0; scope < gpuProfiler.scopeCount(); scope++) {
+            const std::string& name = gpuProfiler.scopeName(scope);
+            if (gpuProfiler.hasTimings()) {
+                benchmark.recordGpuTime(frame, name, gpuProfiler.lastMilliseconds(scope));
+            }
+            if (gpuProfiler.hasCounters(scope)) {
+                const PipelineCounters& counters = gpuProfiler.lastCounters(scope);
+                recordPipelineCounters(frame, name, counters);
+                if (options.logPipelineStatistics) {
+                    std::cout << "Frame " << frame << " " << name << ": vertex invocations " << counters.vertexInvocations
+                              << ", clipping primitives " << counters.clippingPrimitives
+                              << ", fragment invocations " << counters.fragmentInvocations << std::endl;
+                }
+            }
+        }
+        if (gpuProfiler.hasStatistics()) {
+            recordPipelineCounters(frame, "frame", gpuProfiler.lastFrameCounters());
+        }
+    }
+    
+    // Every counter the statistics queries collect, as prefix.counter_name
+    void recordPipelineCounters(uint64_t frame, const std::string& prefix, const PipelineCounters& counters) {
+        benchmark.recordGpuCounter(frame, prefix + ".vertex_invocations", static_cast<double>(counters.vertexInvocations));
+        benchmark.recordGpuCounter(frame, prefix + ".clipping_primitives", static_cast<double>(counters.clippingPrimitives));
+        benchmark.recordGpuCounter(frame, prefix + ".fragment_invocations", static_cast<double>(counters.fragmentInvocations));
+    }
+    
     void createCommandPool() {
-        QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+        TraceZone zone(__func__);
+        QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDeviceCapabilities);
         // Commands are submited to one type of queue. We're drawing, so we requrie the graphics one
         VkCommandPoolCreateInfo poolInfo = {};
         poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
         poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
         
-        if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+        if (vkCreateCommandPool(device, &poolInfo, allocator(HostAllocationObject::CommandPool), &commandPool) != VK_SUCCESS) {
             throw std::runtime_error("Failed to create command pool");
         }
         
     }
     
     void createFramebuffers() {
+        TraceZone zone(__func__);
         // One per image in the swapchain
         swapChainFramebuffers.resize(swapChainImageViews.size());
         for (size_t i = 0; i < swapChainImageViews.size(); i++) {
@@ -291,7 +729,7 @@ class HelloTriangleApplication {
             framebufferInfo.height = swapChainExtent.height;
             framebufferInfo.layers = 1;
             
-            if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &swapChainFramebuffers[i]) != VK_SUCCESS) {
+            if (vkCreateFramebuffer(device, &framebufferInfo, allocator(HostAllocationObject::Framebuffer), &swapChainFramebuffers[i]) != VK_SUCCESS) {
                 throw std::runtime_error("Failed to create framebuffer");
             }
         
@@ -299,6 +737,7 @@ class HelloTriangleApplication {
     }
     
     void createRenderPass() {
+        TraceZone zone(__func__);
         VkAttachmentDescription colorAttachment = {};
         colorAttachment.format = swapChainImageFormat;
         // no multisampling
@@ -316,8 +755,8 @@ class HelloTriangleApplication {
         colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         // format when we load
         colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        // format when we save. Has to do with what we're doing next with it
-        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        // format when we save. Has to do with what we're doing next with it: presenting it, or when headless, copying it somewhere
+        colorAttachment.finalLayout = options.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
         
         VkAttachmentReference colorAttachmentRef = {};
         colorAttachmentRef.attachment = 0; // this binds to location(layout=0) in the fragment shader
@@ -345,12 +784,13 @@ class HelloTriangleApplication {
         renderPassInfo.dependencyCount = 1;
         renderPassInfo.pDependencies = &dependency;
         
-        if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+        if (vkCreateRenderPass(device, &renderPassInfo, allocator(HostAllocationObject::RenderPass), &renderPass) != VK_SUCCESS) {
             throw std::runtime_error("Failed to create renderpass");
         }
     }
     
     void createGraphicsPipeline() {
+        TraceZone zone(__func__);
         /*
          Creating a graphics pipeline requires a bunch of objects:
          - Shader stages: the shader modules that define the functionality of the programmable stages of the graphics pipeline
@@ -430,6 +870,13 @@ class HelloTriangleApplication {
         viewportState.scissorCount = 1;
         viewportState.pScissors = &scissor;
         
+        // Viewport and scissor are set while recording instead, so a resized swapchain can reuse this pipeline. The values above are then ignored
+        VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+        VkPipelineDynamicStateCreateInfo dynamicState = {};
+        dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamicState.dynamicStateCount = 2;
+        dynamicState.pDynamicStates = dynamicStates;
+        
         // The rasterizer takes geometry and makes it fragments
         VkPipelineRasterizationStateCreateInfo rasterizer = {};
         rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -477,7 +924,7 @@ class HelloTriangleApplication {
         pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
         // wont' need anything for now...
         
-        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, allocator(HostAllocationObject::Pipeline), &pipelineLayout) != VK_SUCCESS) {
             throw std::runtime_error("Failed to create pipeline layout");
         }
         
@@ -492,7 +939,7 @@ class HelloTriangleApplication {
         pipelineInfo.pMultisampleState = &multisampling;
         pipelineInfo.pDepthStencilState = nullptr;
         pipelineInfo.pColorBlendState = &colorBlending;
-        pipelineInfo.pDynamicState = nullptr;
+        pipelineInfo.pDynamicState = &dynamicState;
         pipelineInfo.layout = pipelineLayout;
         pipelineInfo.renderPass = renderPass;
         pipelineInfo.subpass = 0;
@@ -503,16 +950,132 @@ class HelloTriangleApplication {
         
         // second param is a pointer to the pipeline cache, which we dont' have
         // third parameter is the amount of pipelineCreateInfos that we'll input, since this function allows for creating multiple pipielines at once
-        if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to create graphics pipeline");
+        {
+            TraceZone createZone("vkCreateGraphicsPipelines"); // shader compilation happens here
+            if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, allocator(HostAllocationObject::Pipeline), &graphicsPipeline) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create graphics pipeline");
+            }
         }
         
         // it's ok that shader modules' lifetime is local because they are only needed at pipeline creation
-        vkDestroyShaderModule(device, vertShaderModule, nullptr);
-        vkDestroyShaderModule(device, fragShaderModule, nullptr);
+        vkDestroyShaderModule(device, vertShaderModule, allocator(HostAllocationObject::ShaderModule));
+        vkDestroyShaderModule(device, fragShaderModule, allocator(HostAllocationObject::ShaderModule));
+    }
+    
+    // Same fixed-function setup as createGraphicsPipeline, except for what the overlay needs: real vertices, no culling and alpha blending
+    void createHudPipeline() {
+        TraceZone zone(__func__);
+        auto vertShaderCode = readFile("shaders/hud_vert.spv");
+        auto fragShaderCode = readFile("shaders/hud_frag.spv");
+        
+        VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
+        VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
+        
+        VkPipelineShaderStageCreateInfo shaderStages[2] = {};
+        shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+        shaderStages[0].module = vertShaderModule;
+        shaderStages[0].pName = "main";
+        shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        shaderStages[1].module = fragShaderModule;
+        shaderStages[1].pName = "main";
+        
+        // This time the vertices do come from a buffer: a clip space position and a color each
+        auto bindingDescription = HudOverlay::bindingDescription();
+        auto attributeDescriptions = HudOverlay::attributeDescriptions();
+        VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+        vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        vertexInputInfo.vertexBindingDescriptionCount = 1;
+        vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+        vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+        vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+        
+        VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+        inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+        inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST; // two triangles per quad
+        inputAssembly.primitiveRestartEnable = VK_FALSE;
+        
+        // Dynamic, like the main pipeline, so the values set in createCommandBuffers apply to both
+        VkPipelineViewportStateCreateInfo viewportState = {};
+        viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+        viewportState.viewportCount = 1;
+        viewportState.scissorCount = 1;
+        
+        VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+        VkPipelineDynamicStateCreateInfo dynamicState = {};
+        dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamicState.dynamicStateCount = 2;
+        dynamicState.pDynamicStates = dynamicStates;
+        
+        VkPipelineRasterizationStateCreateInfo rasterizer = {};
+        rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+        rasterizer.depthClampEnable = VK_FALSE;
+        rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+        rasterizer.lineWidth = 1.0f;
+        // Quads are flat on the screen, there's no back to cull. Saves caring about winding when building them
+        rasterizer.cullMode = VK_CULL_MODE_NONE;
+        rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+        rasterizer.depthBiasEnable = VK_FALSE;
+        
+        VkPipelineMultisampleStateCreateInfo multisampling = {};
+        multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+        multisampling.sampleShadingEnable = VK_FALSE;
+        multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+        
+        // The panel is translucent: new color * alpha + old color * (1 - alpha)
+        VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+        colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        colorBlendAttachment.blendEnable = VK_TRUE;
+        colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+        colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+        colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+        
+        VkPipelineColorBlendStateCreateInfo colorBlending = {};
+        colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+        colorBlending.logicOpEnable = VK_FALSE;
+        colorBlending.attachmentCount = 1;
+        colorBlending.pAttachments = &colorBlendAttachment;
+        
+        // No descriptors or push constants, the vertices carry everything
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, allocator(HostAllocationObject::Pipeline), &hudPipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create HUD pipeline layout");
+        }
+        
+        VkGraphicsPipelineCreateInfo pipelineInfo = {};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipelineInfo.stageCount = 2;
+        pipelineInfo.pStages = shaderStages;
+        pipelineInfo.pVertexInputState = &vertexInputInfo;
+        pipelineInfo.pInputAssemblyState = &inputAssembly;
+        pipelineInfo.pViewportState = &viewportState;
+        pipelineInfo.pRasterizationState = &rasterizer;
+        pipelineInfo.pMultisampleState = &multisampling;
+        pipelineInfo.pColorBlendState = &colorBlending;
+        pipelineInfo.pDynamicState = &dynamicState;
+        pipelineInfo.layout = hudPipelineLayout;
+        pipelineInfo.renderPass = renderPass;
+        pipelineInfo.subpass = 0;
+        pipelineInfo.basePipelineIndex = -1;
+        
+        {
+            TraceZone createZone("vkCreateGraphicsPipelines");
+            if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, allocator(HostAllocationObject::Pipeline), &hudPipeline) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create HUD pipeline");
+            }
+        }
+        
+        vkDestroyShaderModule(device, vertShaderModule, allocator(HostAllocationObject::ShaderModule));
+        vkDestroyShaderModule(device, fragShaderModule, allocator(HostAllocationObject::ShaderModule));
     }
     
     VkShaderModule createShaderModule(const std::vector<char>& code) {
+        TraceZone zone(__func__);
         VkShaderModuleCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
         createInfo.codeSize = code.size();
@@ -520,7 +1083,7 @@ class HelloTriangleApplication {
         createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
         
         VkShaderModule shaderModule;
-        if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+        if (vkCreateShaderModule(device, &createInfo, allocator(HostAllocationObject::ShaderModule), &shaderModule) != VK_SUCCESS) {
             throw std::runtime_error("Failed to create shader module");
         }
         
@@ -528,6 +1091,7 @@ class HelloTriangleApplication {
     }
     
     void createImageViews() {
+        TraceZone zone(__func__);
         // We need as many views as there are images
         swapChainImageViews.resize(swapChainImages.size());
         
@@ -550,26 +1114,19 @@ class HelloTriangleApplication {
             // If it were stereoscopic, we would create one view per layer of an image
             createInfo.subresourceRange.layerCount = 1;
             
-            if (vkCreateImageView(device, &createInfo, nullptr, &swapChainImageViews[i]) != VK_SUCCESS) {
+            if (vkCreateImageView(device, &createInfo, allocator(HostAllocationObject::ImageView), &swapChainImageViews[i]) != VK_SUCCESS) {
                 throw std::runtime_error("Failed to create image views");
                 };
         }
     }
     
-    void createSwapChain() {
+    void createSwapChain(VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE) {
+        TraceZone zone(__func__);
         SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice);
         VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
-        VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+        VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes, presentPolicy);
         VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
-        
-        // theres a min and max number of images on the swap chain, it varies by implementation
-        // If we stick to the minimum, we'll have to wait a lot, so we require at lest one one than the min
-        uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
-        
-        // there's a special value 0 for the max which means "no max". Either way, let's try not to get over the max if there's any
-        if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) {
-            imageCount = swapChainSupport.capabilities.maxImageCount;
-        }
+        uint32_t imageCount = chooseSwapImageCount(swapChainSupport.capabilities, presentMode, presentPolicy);
         
         VkSwapchainCreateInfoKHR createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
@@ -584,9 +1141,9 @@ class HelloTriangleApplication {
         createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR; // Ignore alpha channel
         createInfo.presentMode = presentMode;
         createInfo.clipped = VK_TRUE; // Don't write to pixels covered by other windows
-        createInfo.oldSwapchain = VK_NULL_HANDLE; // This would be used if we wanted to recreate the swap chain, we would point to the old one
+        createInfo.oldSwapchain = oldSwapChain; // When recreating, pointing at the old swapchain lets the driver hand over its resources and keep presenting smoothly
         
-        QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+        QueueFamilyIndices indices = findQueueFamilies(physicalDeviceCapabilities);
         uint32_t queueFamilyIndices[] = {indices.graphicsFamily.value(), indices.presentFamily.value()};
         
         // Some GPUs will have the same family for graphics and presentation, some will have different families
@@ -602,8 +1159,11 @@ class HelloTriangleApplication {
             createInfo.pQueueFamilyIndices = nullptr; // optional
         }
         
-        if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain) != VK_SUCCESS) {
-            throw std::runtime_error("Could not create swap chain");
+        {
+            TraceZone createZone("vkCreateSwapchainKHR");
+            if (vkCreateSwapchainKHR(device, &createInfo, allocator(HostAllocationObject::Swapchain), &swapChain) != VK_SUCCESS) {
+                throw std::runtime_error("Could not create swap chain");
+            }
         }
         
         
@@ -617,199 +1177,967 @@ class HelloTriangleApplication {
         //store format and extent in member variables for future use
         swapChainImageFormat = surfaceFormat.format;
         swapChainExtent = extent;
+        swapChainPresentMode = presentMode;
+    }
+    
+    // Headless replacement for createSwapChain: images we create and back with memory ourselves. They are rendered to round-robin and never presented
+    void createOffscreenImages() {
+        TraceZone zone(__func__);
+        swapChainImageFormat = VK_FORMAT_R8G8B8A8_UNORM; // every device must support rendering to this one
+        swapChainExtent = {static_cast<uint32_t>(WIDTH), static_cast<uint32_t>(HEIGHT)};
+        
+        // No presentation engine holds on to finished images, so one per frame in flight is enough to never wait on an image
+        swapChainImages.resize(options.maxFramesInFlight);
+        offscreenImageMemory.resize(options.maxFramesInFlight);
+        for (size_t i = 0; i < swapChainImages.size(); i++) {
+            VkImageCreateInfo imageInfo = {};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.format = swapChainImageFormat;
+            imageInfo.extent = {swapChainExtent.width, swapChainExtent.height, 1};
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL; // the GPU's own layout, we never map it
+            imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT; // draw to it, and allow copying the result out
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            
+            if (vkCreateImage(device, &imageInfo, allocator(HostAllocationObject::Image), &swapChainImages[i]) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create offscreen image");
+            }
+            
+            // Unlike swapchain images, these come without memory
+            VkMemoryRequirements memRequirements;
+            vkGetImageMemoryRequirements(device, swapChainImages[i], &memRequirements);
+            VkMemoryAllocateInfo allocInfo = {};
+            allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            allocInfo.allocationSize = memRequirements.size;
+            allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            if (vkAllocateMemory(device, &allocInfo, allocator(HostAllocationObject::Memory), &offscreenImageMemory[i]) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to allocate offscreen image memory");
+            }
+            vkBindImageMemory(device, swapChainImages[i], offscreenImageMemory[i], 0);
+        }
+    }
+    
+    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+        // typeFilter has a bit set for every memory type the resource can live in. Take the first of those with the properties we want
+        const VkPhysicalDeviceMemoryProperties& memProperties = physicalDeviceCapabilities.memoryProperties;
+        for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+            if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+                return i;
+            }
+        }
+        throw std::runtime_error("Failed to find a suitable memory type");
+    }
+    
+    bool recreateSwapChain() {
+        // The size comes from the resize events, glfwGetFramebufferSize may only be called on the main thread
+        windowMinimized = framebufferWidth == 0 || framebufferHeight == 0;
+        if (windowMinimized) {
+            return false; // try again once the window is restored
+        }
+        
+        // Frames already submitted still reference the current objects, and the presentation engine may hold on to the last images a little longer.
+        // Keep them around until maxFramesInFlight frames after the last one submitted have finished and the new swapchain has presented.
+        RetiredSwapChain retired;
+        retired.swapChain = swapChain;
+        retired.imageViews = std::move(swapChainImageViews);
+        retired.framebuffers = std::move(swapChainFramebuffers);
+        retired.commandBuffers = std::move(commandBuffers);
+        retired.queryPools = gpuProfiler.releasePools();
+        retired.hudBuffers = hud.releaseBuffers();
+        retired.retireAfterFrame = graphicsTimeline.submitted + options.maxFramesInFlight;
+        if (!presentFencesEnabled) {
+            // No way to ask the presentation engine, so give it time: it can't be holding more presents than the swapchain has images
+            retired.retireAfterFrame += swapChainImages.size();
+        }
+        retired.lastPresent = presentsQueued;
+        retiredSwapChains.push_back(std::move(retired));
+        
+        // The render pass and pipeline only depend on the image format, which does not change on resize, so they are kept
+        createSwapChain(retiredSwapChains.back().swapChain);
+        createImageViews();
+        createFramebuffers();
+        createCommandBuffers();
+        imageFrameNumbers.assign(swapChainImages.size(), 0); // new images, nobody has used them yet
+        
+        swapChainOutOfDate = false;
+        return true;
+    }
+    
+    // completedFrame is how far graphicsTimeline got. UINT64_MAX means the device is idle and everything can go
+    void destroyRetiredSwapChains(uint64_t completedFrame) {
+        bool deviceIdle = completedFrame == UINT64_MAX;
+        if (!deviceIdle) {
+            pollPresentFences();
+        }
+        // Retired in order, so we can stop at the first one that is still busy
+        while (!retiredSwapChains.empty() && retiredSwapChains.front().retireAfterFrame <= completedFrame) {
+            RetiredSwapChain& retired = retiredSwapChains.front();
+            if (!deviceIdle) {
+                // The timeline only covers our submissions. The presentation engine handles presents in order, so once a present on a newer
+                // swapchain is done with, the old one is too. With present fences we know when that is; without, retireAfterFrame has a margin
+                // for it, and there has to have been such a present at all
+                uint64_t presentedSince = presentFencesEnabled ? completedFencedPresent : presentsQueued;
+                if (presentedSince <= retired.lastPresent) break;
+            }
+            vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(retired.commandBuffers.size()), retired.commandBuffers.data());
+            gpuProfiler.destroyPools(retired.queryPools);
+            hud.destroyBuffers(retired.hudBuffers);
+            for (auto framebuffer : retired.framebuffers) {
+                vkDestroyFramebuffer(device, framebuffer, allocator(HostAllocationObject::Framebuffer));
+            }
+            for (auto imageView : retired.imageViews) {
+                vkDestroyImageView(device, imageView, allocator(HostAllocationObject::ImageView));
+            }
+            presentWaiter.forget(retired.swapChain); // until now it was still waiting for the last presents on it
+            vkDestroySwapchainKHR(device, retired.swapChain, allocator(HostAllocationObject::Swapchain));
+            retiredSwapChains.pop_front();
+        }
+    }
+    
+    // Never blocks: only takes the fences that have already signaled
+    void pollPresentFences() {
+        while (!presentFences.empty() && vkGetFenceStatus(device, presentFences.front().fence) == VK_SUCCESS) {
+            VkFence fence = presentFences.front().fence;
+            completedFencedPresent = presentFences.front().present;
+            presentFences.pop_front();
+            vkResetFences(device, 1, &fence);
+            freePresentFences.push_back(fence);
+        }
+    }
+    
+    VkFence takePresentFence() {
+        if (!freePresentFences.empty()) {
+            VkFence fence = freePresentFences.back();
+            freePresentFences.pop_back();
+            return fence;
+        }
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VkFence fence;
+        if (vkCreateFence(device, &fenceInfo, allocator(HostAllocationObject::Fence), &fence) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create present fence");
+        }
+        return fence;
+    }
+    
+    // With the device idle. Accepted presents do signal their fences, the swapchains they're on can't go before that
+    void destroyPresentFences() {
+        for (const PresentFence& pending : presentFences) {
+            vkWaitForFences(device, 1, &pending.fence, VK_TRUE, UINT64_MAX);
+            freePresentFences.push_back(pending.fence);
+        }
+        presentFences.clear();
+        freePresentFences.insert(freePresentFences.end(), rejectedPresentFences.begin(), rejectedPresentFences.end());
+        rejectedPresentFences.clear();
+        for (VkFence fence : freePresentFences) {
+            vkDestroyFence(device, fence, allocator(HostAllocationObject::Fence));
+        }
+        freePresentFences.clear();
     }
     
     void createSurface() {
+        TraceZone zone(__func__);
         // Creating an instance VkSurfaceKHR is platform dependant (while VkSurfaceKHR itself is not). We could use platform-specific methods to create it or, since we're using GLFW, use its own abstractions that will deal with that
-        if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS) {
+        if (glfwCreateWindowSurface(instance, window, allocator(HostAllocationObject::Surface), &surface) != VK_SUCCESS) {
             throw std::runtime_error("Failed to create window surface");
         }
     }
     
     void createLogicalDevice() {
+        TraceZone zone(__func__);
         
         // Create the actual logical queues we're interested in using
-        QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
-        
-        // Since we're going to need more than one queue...
-        std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-        std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
-        float queuePriority = 1.0f;
-        
-        for (uint32_t queueFamily: uniqueQueueFamilies) {
-            // Define each VkDeviceQueueCreateInfo...
-            VkDeviceQueueCreateInfo queueCreateInfo = {};
-            queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-            queueCreateInfo.queueFamilyIndex = queueFamily;
-            queueCreateInfo.queueCount = 1;
-            queueCreateInfo.pQueuePriorities = &queuePriority;
-
-            // ...and push them to the vector
-            queueCreateInfos.push_back(queueCreateInfo);
+        QueueFamilyIndices indices = findQueueFamilies(physicalDeviceCapabilities);
+        
+        // Since we're going to need more than one queue, the plan decides how many to create in each family and with what priority
+        queuePlan = QueuePlan::make(physicalDeviceCapabilities.queueFamilies, indices.graphicsFamily.value(), indices.presentFamily.value(),
+                                    indices.computeFamily, indices.transferFamily);
+        std::vector<VkDeviceQueueCreateInfo> queueCreateInfos = queuePlan.createInfos();
+        if (options.verbose) {
+            queuePlan.print();
         }
         
-        // Enable the GPU features we want to use. Right now we won't as for any
+        // Enable the GPU features we want to use. Only optional ones so far, switched on when the device has them
+        const VkPhysicalDeviceFeatures& supportedFeatures = physicalDeviceCapabilities.features;
         VkPhysicalDeviceFeatures deviceFeatures = {};
+        deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery; // the GPU profiler's vertex/fragment counters
+        pipelineStatisticsEnabled = supportedFeatures.pipelineStatisticsQuery == VK_TRUE;
+        
+        // Newer features are switched on by chaining their structs through pNext. The feature chain has everything from the optional feature
+        // table the device supports, with the extensions it takes to get them on this device's API version
+        FeatureChain featureChain(physicalDeviceCapabilities);
+        
+        // Optional extensions are appended only when the device has them
+        std::vector<const char*> enabledExtensions = requiredDeviceExtensions();
+        enabledExtensions.insert(enabledExtensions.end(), featureChain.extensions().begin(), featureChain.extensions().end());
+        VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {};
+        presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+        presentIdFeatures.presentId = VK_TRUE;
+        VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {};
+        presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+        presentWaitFeatures.presentWait = VK_TRUE;
+        VkPhysicalDeviceSwapchainMaintenance1FeaturesEXT swapchainMaintenanceFeatures = {};
+        swapchainMaintenanceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SWAPCHAIN_MAINTENANCE_1_FEATURES_EXT;
+        swapchainMaintenanceFeatures.swapchainMaintenance1 = VK_TRUE;
+        void* presentFeatures = nullptr; // the present structs above that we enable, for the feature chain
+        presentFencesEnabled = !options.headless && surfaceMaintenanceAvailable && physicalDeviceCapabilities.swapchainMaintenance1;
+        if (presentFencesEnabled) {
+            enabledExtensions.push_back(VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME);
+            presentFeatures = &swapchainMaintenanceFeatures;
+        }
+        presentWaitEnabled = !options.headless && checkPresentWaitSupport(physicalDeviceCapabilities); // headless never presents
+        if (presentWaitEnabled) {
+            enabledExtensions.insert(enabledExtensions.end(), presentWaitExtensions.begin(), presentWaitExtensions.end());
+            presentWaitFeatures.pNext = presentFeatures;
+            presentIdFeatures.pNext = &presentWaitFeatures;
+            presentFeatures = &presentIdFeatures;
+        } else if (!options.headless && (options.maxQueuedPresents > 0 || options.logFrameLatency)) {
+            std::cout << "VK_KHR_present_wait not available: frame pacing and input-to-photon latency are disabled" << std::endl;
+        }
+        // No features to enable, the extension only adds a struct to query
+        bool memoryBudgetSupported = physicalDeviceCapabilities.hasExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        if (memoryBudgetSupported) {
+            enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        }
         
         VkDeviceCreateInfo deviceCreateInfo = {};
         deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        deviceCreateInfo.pNext = featureChain.chain(presentFeatures);
         deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
         deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
         deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
-        deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
-        if (enableValidationLayers) {
+        deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+        deviceCreateInfo.ppEnabledExtensionNames = enabledExtensions.data();
+        if (validationEnabled()) {
             deviceCreateInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
             deviceCreateInfo.ppEnabledLayerNames = validationLayers.data();
         } else {
             deviceCreateInfo.enabledLayerCount = 0;
         }
         
-        if (vkCreateDevice(physicalDevice, &deviceCreateInfo, nullptr, &device) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to create logical device");
+        {
+            TraceZone createZone("vkCreateDevice");
+            if (vkCreateDevice(physicalDevice, &deviceCreateInfo, allocator(HostAllocationObject::Device), &device) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create logical device");
+            }
         }
+        enabledFeatures = physicalDeviceCapabilities.optionalFeatures;
         
-        // This stores a handle to a graphics queue in graphicsQueue. The 0 is the index of the queue within the family. A device can potentially provice multiple queues for the same family. In this case we're only interested in one, so the first one suffices.
-        vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
-        vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+        if (memoryBudgetSupported) {
+            memoryBudget.init(instance, physicalDevice, physicalDeviceCapabilities.memoryProperties, options.memoryBudgetWarning);
+        } else if (options.verbose) {
+            std::cout << "VK_EXT_memory_budget not available: no GPU memory budget telemetry" << std::endl;
+        }
+        
+        // This stores a handle to a graphics queue in graphicsQueue. The second parameter is the index of the queue within the family: a device can provide multiple queues for the same family, and we may have created several
+        const QueuePlan::Queue& graphics = queuePlan.queue(QueueRole::Graphics);
+        const QueuePlan::Queue& present = queuePlan.queue(QueueRole::Present);
+        const QueuePlan::Queue& compute = queuePlan.queue(QueueRole::Compute);
+        const QueuePlan::Queue& transfer = queuePlan.queue(QueueRole::Transfer);
+        vkGetDeviceQueue(device, graphics.family, graphics.index, &graphicsQueue);
+        vkGetDeviceQueue(device, present.family, present.index, &presentQueue);
+        vkGetDeviceQueue(device, compute.family, compute.index, &computeQueue);
+        vkGetDeviceQueue(device, transfer.family, transfer.index, &transferQueue);
+        
+        // From here on the per-frame calls go straight to the driver instead of through the loader's trampolines
+        dispatch.load(device, enabledFeatures, !options.headless, presentWaitEnabled);
+        presentWaitEnabled = dispatch.vkWaitForPresentKHR != nullptr;
+        if (presentWaitEnabled) {
+            presentWaiter.init(device, dispatch.vkWaitForPresentKHR);
+        }
     }
     
 
-    void printPhysicalDeviceInfo(VkPhysicalDevice_T *const &device) {
-        VkPhysicalDeviceProperties deviceProperties;
-        vkGetPhysicalDeviceProperties(device, &deviceProperties);
-        std::ios_base::fmtflags f( std::cout.flags()); // Save std flags to restore them later. Changing output to hex is stateful
-        std::cout << "DeviceId=" << deviceProperties.deviceID << ". VendorId=0x" << std::hex << deviceProperties.vendorID << ". API version=" << std::dec << deviceProperties.apiVersion << std::endl;
-        std::cout.flags(f);
+    // Looks the device up in deviceSurfaceInfo first: only the first call per device asks every family about present support
+    QueueFamilyIndices findQueueFamilies(const DeviceCapabilities& capabilities) {
+        DeviceSurfaceInfo& info = surfaceInfo(capabilities.device);
+        if (!info.queueFamilies.has_value()) {
+            info.queueFamilies = discoverQueueFamilies(capabilities);
+        }
+        return info.queueFamilies.value();
     }
     
-    QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device) {
+    QueueFamilyIndices discoverQueueFamilies(const DeviceCapabilities& capabilities) {
         QueueFamilyIndices indices;
         
-        uint32_t queueFamilyCount  = 0;
-        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
-        
-        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
-        
-        int i = 0;
-        for (const auto& queueFamily: queueFamilies) {
-            if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+        // First match wins for each, with two preferences: a graphics family that can also present (one queue does both, no image
+        // hand-over between families), and for compute/transfer the families that do nothing else, so they're separate hardware queues
+        uint32_t i = 0;
+        for (const auto& queueFamily: capabilities.queueFamilies) {
+            bool graphics = queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT;
+            bool compute = queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT;
+            bool transfer = queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT;
+            VkBool32 presentSupport = false;
+            if (surface != VK_NULL_HANDLE) {
+                vkGetPhysicalDeviceSurfaceSupportKHR(capabilities.device, i, surface, &presentSupport);
+            }
+            
+            if (graphics && presentSupport && !(indices.graphicsFamily.has_value() && indices.graphicsFamily == indices.presentFamily)) {
                 indices.graphicsFamily = i;
+                indices.presentFamily = i;
             }
-            VkBool32 presentSupport = false;
-            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
-            if (presentSupport) {
+            if (graphics && !indices.graphicsFamily.has_value()) {
+                indices.graphicsFamily = i;
+            }
+            if (presentSupport && !indices.presentFamily.has_value()) {
                 indices.presentFamily = i;
             }
+            if (compute && !graphics && !indices.computeFamily.has_value()) {
+                indices.computeFamily = i;
+            }
+            if (transfer && !graphics && !compute && !indices.transferFamily.has_value()) {
+                indices.transferFamily = i;
+            }
             i++;
         }
         
+        if (surface == VK_NULL_HANDLE) {
+            // Headless: there's nothing to present to. Letting the graphics queue stand in keeps the queue setup the same
+            indices.presentFamily = indices.graphicsFamily;
+        }
+        
         return indices;
     }
     
     void pickPhysicalDevice() {
+        TraceZone zone(__func__);
         uint32_t deviceCount = 0;
         vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
         
         if (deviceCount == 0) {
             throw std::runtime_error("Failed to find Vulkan GPUs");
-        } else {
+        } else if (options.verbose) {
             std::cout << "GPUs found: " << deviceCount << std::endl;
         }
         
         std::vector<VkPhysicalDevice> devices(deviceCount);
         vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
         
-        for (const auto& device: devices) {
-            if (isDeviceSuitable(device)) {
-                std::cout << "Found Device: ";
-                printPhysicalDeviceInfo(device); // Restore std state
-                physicalDevice = device; //This effectively makes the last GPU found on multi-GPU systems the one chosen
+        // Enumeration order means nothing (on multi-GPU machines it may well put the integrated or a software device last),
+        // so unless told otherwise we score every suitable device and take the best
+        if (!options.device.empty()) {
+            useRequestedDevice(devices);
+        } else if (!useCachedDevice(devices)) {
+            useBestScoringDevice(devices);
+        }
+        
+        if (options.verbose) {
+            std::cout << "Chosen Device: ";
+            printDeviceCapabilities(physicalDeviceCapabilities);
+        }
+    }
+    
+    // --device: that one or an error, never a fallback to something else. Not cached, the override is for this run only
+    void useRequestedDevice(const std::vector<VkPhysicalDevice>& devices) {
+        VkPhysicalDevice requested = VK_NULL_HANDLE;
+        DeviceUUID uuid;
+        if (options.device.size() <= 3 && options.device.find_first_not_of("0123456789") == std::string::npos) {
+            size_t index = std::stoul(options.device);
+            if (index >= devices.size()) {
+                throw std::runtime_error("--device=" + options.device + ": there are only " + std::to_string(devices.size()) + " GPUs");
+            }
+            requested = devices[index];
+        } else if (parseDeviceUUID(options.device, uuid)) {
+            if (!deviceUUIDsAvailable) {
+                throw std::runtime_error("--device: this Vulkan installation can't report device UUIDs, use an index instead");
+            }
+            requested = findDeviceByUUID(devices, uuid);
+            if (requested == VK_NULL_HANDLE) {
+                throw std::runtime_error("--device: no GPU with UUID " + formatDeviceUUID(uuid));
+            }
+        } else {
+            throw std::runtime_error("--device needs an index or a 32 digit UUID: '" + options.device + "'");
+        }
+        
+        DeviceCapabilities capabilities = queryDeviceCapabilities(instance, requested, instanceApiVersion);
+        if (!isDeviceSuitable(capabilities)) {
+            throw std::runtime_error(std::string("The requested GPU ") + capabilities.properties.deviceName + " lacks queues, extensions or features we need");
+        }
+        physicalDevice = requested;
+        physicalDeviceCapabilities = std::move(capabilities);
+    }
+    
+    // Whatever we settled on last time, if it's still there and still suitable. Only that one device gets queried, instead of all of them.
+    // A GPU added or removed since changes the device count, and then they're all scored again
+    bool useCachedDevice(const std::vector<VkPhysicalDevice>& devices) {
+        std::string path = deviceCachePath();
+        DeviceUUID uuid;
+        uint32_t cachedDeviceCount = 0;
+        if (path.empty() || !deviceUUIDsAvailable || !readCachedDevice(path, uuid, cachedDeviceCount)) return false;
+        if (cachedDeviceCount != devices.size()) return false;
+        
+        VkPhysicalDevice cached = findDeviceByUUID(devices, uuid);
+        if (cached == VK_NULL_HANDLE) return false; // removed, or a driver update changed its UUID
+        DeviceCapabilities capabilities = queryDeviceCapabilities(instance, cached, instanceApiVersion);
+        if (!isDeviceSuitable(capabilities)) return false; // chosen by a headless run, say, and this one needs to present
+        
+        if (options.verbose) {
+            std::cout << "Using the device remembered in " << path << std::endl;
+        }
+        physicalDevice = cached;
+        physicalDeviceCapabilities = std::move(capabilities);
+        return true;
+    }
+    
+    void useBestScoringDevice(const std::vector<VkPhysicalDevice>& devices) {
+        double bestScore = -1.0;
+        for (size_t i = 0; i < devices.size(); i++) {
+            // Everything the checks below need, in one go. The chosen device's snapshot is kept for device creation
+            DeviceCapabilities capabilities = queryDeviceCapabilities(instance, devices[i], instanceApiVersion);
+            if (!isDeviceSuitable(capabilities)) continue;
+            
+            DeviceScore score = scoreDevice(capabilities);
+            if (options.verbose) {
+                std::cout << "Found Device " << i << ": ";
+                printDeviceCapabilities(capabilities);
+                DeviceUUID uuid;
+                if (deviceUUIDsAvailable && queryDeviceUUID(instance, devices[i], uuid)) {
+                    std::cout << "  UUID " << formatDeviceUUID(uuid) << ", ";
+                } else {
+                    std::cout << "  ";
+                }
+                printDeviceScore(score);
+            }
+            if (score.total() > bestScore) { // ties go to the first one, so the choice doesn't flip between runs
+                bestScore = score.total();
+                physicalDevice = devices[i];
+                physicalDeviceCapabilities = std::move(capabilities);
             }
         }
         
         if (physicalDevice == VK_NULL_HANDLE) {
             throw std::runtime_error("Failed to select a suitable GPU");
-        } else {
-            std::cout << "Chosen Device: ";
-            printPhysicalDeviceInfo(physicalDevice);
+        }
+        
+        // Only remember choices made the way a normal run would make them. Headless and benchmark runs are what scripts and CI do,
+        // often with the loader pointed at a software driver: caching that would quietly put every later run on the CPU
+        if (options.headless || options.benchmarkFrames > 0 || driversRestricted()) return;
+        std::string path = deviceCachePath();
+        DeviceUUID uuid;
+        if (!path.empty() && deviceUUIDsAvailable && queryDeviceUUID(instance, physicalDevice, uuid)) {
+            writeCachedDevice(path, uuid, static_cast<uint32_t>(devices.size()), physicalDeviceCapabilities.properties.deviceName);
         }
     }
     
-    bool isDeviceSuitable(VkPhysicalDevice device) {
-        QueueFamilyIndices indices = findQueueFamilies(device);
-        bool extensionsSupported = checkDeviceExtensionSupport(device);
+    VkPhysicalDevice findDeviceByUUID(const std::vector<VkPhysicalDevice>& devices, const DeviceUUID& uuid) {
+        for (VkPhysicalDevice device : devices) {
+            DeviceUUID candidate;
+            if (queryDeviceUUID(instance, device, candidate) && candidate == uuid) {
+                return device;
+            }
+        }
+        return VK_NULL_HANDLE;
+    }
+    
+    std::string deviceCachePath() const {
+        if (options.deviceCachePath == "off") return "";
+        return options.deviceCachePath.empty() ? defaultDeviceCachePath() : options.deviceCachePath;
+    }
+    
+    bool isDeviceSuitable(const DeviceCapabilities& capabilities) {
+        QueueFamilyIndices indices = findQueueFamilies(capabilities);
+        bool extensionsSupported = checkDeviceExtensionSupport(capabilities);
         
-        bool swapChainAdequate = false; // Assume the worse
-        if (extensionsSupported) { // important to query about swap chain support if and only if the extension is available
-            SwapChainSupportDetails swapChainSupoprt = querySwapChainSupport(device);
+        bool swapChainAdequate = options.headless; // Assume the worse, unless we don't need a swapchain at all
+        if (extensionsSupported && !options.headless) { // important to query about swap chain support if and only if the extension is available
+            const DeviceSurfaceInfo& swapChainSupoprt = querySurfaceFormats(capabilities.device); // the surface capabilities aren't needed to decide
             swapChainAdequate = !swapChainSupoprt.formats.empty() && !swapChainSupoprt.presentModes.empty();
         }
         
-        return indices.graphicsFamily.has_value() && indices.presentFamily.has_value() && extensionsSupported && swapChainAdequate; // We require a graphics queue, a presentation queue and proper swapchain support
+        bool timelineSupported = capabilities.optionalFeatures.timelineSemaphore; // core from 1.2, and having the extension does not guarantee the feature
+        
+        return indices.graphicsFamily.has_value() && indices.presentFamily.has_value() && extensionsSupported && swapChainAdequate && timelineSupported; // We require a graphics queue, a presentation queue, proper swapchain support and timeline semaphores
     }
     
-    bool checkDeviceExtensionSupport(VkPhysicalDevice device) {
-        uint32_t extensionCount;
-        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
-        
-        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
-        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+    bool checkPresentWaitSupport(const DeviceCapabilities& capabilities) {
+        return capabilities.hasExtensions(presentWaitExtensions) && capabilities.presentId && capabilities.presentWait;
+    }
+    
+    std::vector<const char*> requiredDeviceExtensions() {
+        std::vector<const char*> extensions;
+        if (!options.headless) {
+            extensions.insert(extensions.end(), swapChainExtensions.begin(), swapChainExtensions.end());
+        }
+        return extensions;
+    }
+    
+    bool checkDeviceExtensionSupport(const DeviceCapabilities& capabilities) {
+        // The extension list was enumerated once, in queryDeviceCapabilities
+        return capabilities.hasExtensions(requiredDeviceExtensions());
+    }
+    
+    void mainLoop() {
+        startPresentPolicyMeasurement();
+        hostAllocations.beginFrames(); // anything allocated from here on is per-frame churn
+        if (options.headless) {
+            // No window and no events, just render until we've done the frames we were asked for
+            while (framesRendered < options.frameLimit) {
+                frameLimiter.wait();
+                renderFrameIfNeeded();
+            }
+        } else if (options.renderThread) {
+            // The main thread keeps GLFW (it has to, GLFW event handling is main thread only) and sleeps until there are events.
+            // A slow window system can't delay a frame, and a frame blocked in acquire/present can't delay input handling
+            renderThreadRunning = true;
+            std::thread renderThread(&HelloTriangleApplication::renderLoop, this);
+            while (!glfwWindowShouldClose(window)) {
+                glfwWaitEvents();
+            }
+            renderThreadRunning = false;
+            wakeRenderThread();
+            renderThread.join();
+            if (renderThreadError) {
+                std::rethrow_exception(renderThreadError);
+            }
+        } else {
+            while (!glfwWindowShouldClose(window)) {
+                // The limiter sleeps first and events are polled last, right before recording: input that arrives during the sleep
+                // still makes it into this frame, and its latency still counts from when it happened, sleep included
+                waitForNextFrame();
+                paceFrame();
+                pumpEvents();
+                renderFrameIfNeeded();
+            }
+        }
         
-        std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+        // drawFrame is asynchronous, so there may still be work in flight. Let it finish before cleanup destroys what it uses
+        vkDeviceWaitIdle(device);
+        collectPresentedFrames(); // presents still on their way to the display aren't measured
+        recordFrameLatencies(graphicsTimeline.submitted);
+        for (uint32_t i = 0; i < swapChainImages.size(); i++) {
+            collectGpuTimes(i); // the last frame on each image hasn't been read back yet
+        }
+        printPresentPolicyReport();
+        printFrameStatistics();
+        frameLimiter.printReport();
+        gpuProfiler.printReport();
+        hostAllocations.printReport(framesRendered);
+        memoryBudget.printReport();
+        benchmark.finish(); // the GPU is idle, so the last measured frame is really done
+        writeBenchmarkReport();
+    }
+    
+    void writeBenchmarkReport() {
+        if (!benchmark.enabled()) return;
+        
+        // Enough context to tell two reports apart when comparing builds or drivers
+        const VkPhysicalDeviceProperties& properties = physicalDeviceCapabilities.properties;
+        benchmark.addInfo("device", properties.deviceName);
+        benchmark.addInfo("driver_version", std::to_string(properties.driverVersion));
+        if (options.headless) {
+            benchmark.addInfo("mode", "headless");
+        } else {
+            benchmark.addInfo("mode", std::string(presentPolicyName(presentPolicy)) + " (" + presentModeName(swapChainPresentMode) + ")");
+        }
+        benchmark.addInfo("extent", std::to_string(swapChainExtent.width) + "x" + std::to_string(swapChainExtent.height));
+        benchmark.addInfo("frames_in_flight", std::to_string(options.maxFramesInFlight));
+        benchmark.addInfo("target_frame_ms", std::to_string(options.targetFrameSeconds * 1000.0));
+        benchmark.addInfo("scene", benchmarkScene());
+        
+        benchmark.printSummary();
+        benchmark.writeReport(options.reportPath);
+        std::cout << "Benchmark report written to " << options.reportPath << std::endl;
+        checkBaseline();
+    }
+    
+    // Everything that changes what a frame costs. Two runs are only comparable if this is the same
+    std::string benchmarkScene() const {
+        return "draws=" + std::to_string(options.drawsPerFrame)
+             + " hud=" + (options.hud ? "on" : "off")
+             + " extent=" + std::to_string(swapChainExtent.width) + "x" + std::to_string(swapChainExtent.height)
+             + " mode=" + (options.headless ? "headless" : presentPolicyName(presentPolicy))
+             + " frames_in_flight=" + std::to_string(options.maxFramesInFlight)
+             + " warmup=" + std::to_string(options.warmupFrames)
+             + " frames=" + std::to_string(options.benchmarkFrames)
+             + " validation=" + validationModeName(options.validation);
+    }
+    
+    void checkBaseline() {
+        if (options.baselinePath.empty() && options.writeBaselinePath.empty()) return;
+        
+        PerformanceBaseline current;
+        current.scene = benchmarkScene();
+        current.device = physicalDeviceCapabilities.properties.deviceName;
+        current.metrics = benchmark.baselineMetrics();
+        // Compare before writing, so a run can be checked against a baseline and then replace it
+        if (!options.baselinePath.empty()) {
+            PerformanceBaseline baseline = PerformanceBaseline::read(options.baselinePath);
+            if (baseline.scene != current.scene) {
+                throw std::runtime_error("Baseline " + options.baselinePath + " is for a different scene (" + baseline.scene + "), this run is " + current.scene);
+            }
+            performanceRegressed = current.regressedFrom(baseline, options.baselineTolerance);
+        }
+        if (!options.writeBaselinePath.empty()) {
+            current.write(options.writeBaselinePath);
+            std::cout << "Baseline written to " << options.writeBaselinePath << std::endl;
+        }
+    }
+    
+    void renderLoop() {
+        try {
+            while (renderThreadRunning) {
+                waitForNextFrame(); // same order as the single threaded loop: sleep, then take the latest events
+                paceFrame();
+                waitForRenderWork();
+                renderFrameIfNeeded();
+            }
+        } catch (...) {
+            // Hand the error to the main thread, which rethrows it after joining us
+            renderThreadError = std::current_exception();
+            requestQuit();
+        }
+    }
+    
+    // One iteration of the render side, shared by both threading modes. The frame limiter has already slept, so the input is fresh
+    void renderFrameIfNeeded() {
+        processInputEvents();
+        // Latency counts from when the input happened, including however long the event waited in the queue
+        lastInputFromEvent = unshownInputTime.has_value();
+        lastInputTime = lastInputFromEvent ? *unshownInputTime : std::chrono::steady_clock::now();
+        if (!options.onDemand || needsRedraw) {
+            uint64_t framesBefore = framesRendered;
+            drawFrame();
+            if (framesRendered > framesBefore) {
+                unshownInputTime.reset(); // otherwise (out of date, minimized) the next frame is the one that shows it
+            }
+        }
+        updatePresentSweep();
+        if (options.frameLimit > 0 && framesRendered >= options.frameLimit) {
+            requestQuit();
+        }
+    }
+    
+    // Ends the main loop (and the render thread) from any thread
+    void requestQuit() {
+        renderThreadRunning = false;
+        if (window != nullptr) {
+            glfwSetWindowShouldClose(window, GLFW_TRUE); // safe from any thread
+            glfwPostEmptyEvent(); // wake the main thread if it is sleeping in glfwWaitEvents
+        }
+    }
+    
+    // Main thread, from the GLFW callbacks
+    void postInputEvent(InputEvent event) {
+        event.time = std::chrono::steady_clock::now();
+        while (!inputEvents.push(event)) {
+            if (event.type == InputEvent::Changed) {
+                return; // the queue is full of events, a redraw is coming anyway
+            }
+            // Resizes and keys must not get lost. The renderer drains the queue every frame, so this is short
+            wakeRenderThread();
+            std::this_thread::yield();
+        }
+        wakeRenderThread();
+    }
+    
+    void wakeRenderThread() {
+        if (!options.renderThread) return;
+        // Taking the lock orders the notify after the render thread's predicate check, otherwise the wakeup could be missed
+        std::lock_guard<std::mutex> lock(renderWakeMutex);
+        renderWake.notify_one();
+    }
+    
+    // Render side: applies everything the callbacks reported since the last frame
+    void processInputEvents() {
+        InputEvent event;
+        while (inputEvents.pop(event)) {
+            if (!unshownInputTime) {
+                unshownInputTime = event.time;
+            }
+            switch (event.type) {
+                case InputEvent::FramebufferResized:
+                    framebufferWidth = event.width;
+                    framebufferHeight = event.height;
+                    // Drivers usually report VK_ERROR_OUT_OF_DATE_KHR after a resize, but they are not required to, so we track it ourselves too
+                    framebufferResized = true;
+                    break;
+                case InputEvent::Key:
+                    if (event.key == GLFW_KEY_F1 && event.action == GLFW_PRESS) {
+                        hud.toggle(); // the next frame on each image picks it up, nothing to re-record
+                    }
+                    break;
+                case InputEvent::Changed:
+                    break;
+            }
+            needsRedraw = true;
+        }
+    }
+    
+    // Render thread equivalent of pumpEvents: sleep while there's nothing to draw
+    void waitForRenderWork() {
+        if (!windowMinimized && !(options.onDemand && !needsRedraw)) return;
+        
+        std::unique_lock<std::mutex> lock(renderWakeMutex);
+        auto hasWork = [this] { return !inputEvents.empty() || !renderThreadRunning; };
+        if (!windowMinimized && options.onDemand && options.onDemandRefreshSeconds > 0.0) {
+            auto refreshTime = lastRedrawTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(options.onDemandRefreshSeconds));
+            if (!renderWake.wait_until(lock, refreshTime, hasWork)) {
+                needsRedraw = true; // timed out: periodic refresh is due
+            }
+        } else {
+            renderWake.wait(lock, hasWork);
+        }
+    }
+    
+    void pumpEvents() {
+        if (windowMinimized) {
+            glfwWaitEvents(); // Nothing to draw to, so sleep until the window changes instead of spinning
+            return;
+        }
         
-        for (const auto& extension : availableExtensions) {
-            // the idea here is that we'll erase all required extensions once they're found.
-            requiredExtensions.erase(extension.extensionName);
+        if (options.onDemand && !needsRedraw) {
+            // Nothing changed, so there's nothing new to show: sleep in the OS until an event arrives (or the periodic refresh is due)
+            if (options.onDemandRefreshSeconds > 0.0) {
+                std::chrono::duration<double> sinceRedraw = std::chrono::steady_clock::now() - lastRedrawTime;
+                double remaining = options.onDemandRefreshSeconds - sinceRedraw.count();
+                if (remaining > 0.0) {
+                    glfwWaitEventsTimeout(remaining);
+                }
+                sinceRedraw = std::chrono::steady_clock::now() - lastRedrawTime;
+                if (sinceRedraw.count() >= options.onDemandRefreshSeconds) {
+                    needsRedraw = true;
+                }
+            } else {
+                glfwWaitEvents();
+            }
+            return;
         }
         
-        // if the set is empty, then all the required extensions where found
-        return requiredExtensions.empty();
+        glfwPollEvents(); // Check for events that happen to the window, such as closing it
     }
     
-    void mainLoop() {
-        while (!glfwWindowShouldClose(window)) {
-            glfwPollEvents(); // Wait for events that happen to the window, such as closing it
-            drawFrame();
+    // Idle time before the next frame. With present wait, as much of it as possible is spent inside vkWaitForPresentKHR instead of asleep,
+    // so presents that reach the display meanwhile get their exact display time. On the drawing thread, which is what keeps those waits
+    // synchronized with presenting and recreating the swapchain
+    void waitForNextFrame() {
+        if (presentWaitEnabled && !swapChainOutOfDate) {
+            presentWaiter.waitUntil(frameLimiter.sleepDeadline());
+        }
+        frameLimiter.wait();
+    }
+    
+    // Records the input-to-photon latency of every present the waiter saw reach the display since the last call
+    void collectPresentedFrames() {
+        presentWaiter.takePresented(presentedFrames);
+        for (const PresentWaiter::Presented& frame : presentedFrames) {
+            std::chrono::duration<double, std::milli> latency = frame.displayTime - frame.inputTime;
+            PhotonLatencies& latencies = frame.fromInput ? inputToPhoton : sampleToPhoton;
+            latencies.milliseconds.add(latency.count());
+            if (frame.exact) {
+                latencies.exact++;
+            }
+            if (options.logFrameLatency) {
+                std::cout << "Frame " << frame.presentId << (frame.fromInput ? ": input-to-photon " : ": sample-to-photon ")
+                          << (frame.exact ? "" : "<= ") << latency.count() << " ms" << std::endl;
+            }
+        }
+    }
+    
+    // The pacing controller: the later we sample input, the fresher the frame that reaches the display.
+    // If more than maxQueuedPresents frames are already waiting for the display, anything we start now would just queue behind them,
+    // so wait until the display takes one before we even look at input
+    void paceFrame() {
+        if (!presentWaitEnabled || swapChainOutOfDate) return;
+        
+        if (options.maxQueuedPresents > 0) {
+            presentWaiter.waitUntilPendingBelow(options.maxQueuedPresents);
+        }
+        presentWaiter.waitUntil(std::chrono::steady_clock::time_point()); // only picks up the ones already done
+        collectPresentedFrames();
+    }
+    
+    void startPresentPolicyMeasurement() {
+        frameLatencies.clear();
+        inputToPhoton = PhotonLatencies();
+        sampleToPhoton = PhotonLatencies();
+        policyFrames = 0;
+        policyStart = std::chrono::steady_clock::now();
+    }
+    
+    // Every frame the GPU finished since the last call gets its latency recorded
+    void recordFrameLatencies(uint64_t completedFrame) {
+        auto now = std::chrono::steady_clock::now();
+        while (!pendingFrameStarts.empty() && pendingFrameStarts.front().first <= completedFrame) {
+            std::chrono::duration<double, std::milli> latency = now - pendingFrameStarts.front().second;
+            frameLatencies.add(latency.count());
+            pendingFrameStarts.pop_front();
         }
     }
     
+    void printPresentPolicyReport() {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - policyStart;
+        if (options.headless) {
+            std::cout << "Headless (" << swapChainImages.size() << " offscreen images): ";
+        } else {
+            std::cout << "Present policy " << presentPolicyName(presentPolicy)
+                      << " (" << presentModeName(swapChainPresentMode) << ", " << swapChainImages.size() << " images): ";
+        }
+        std::cout << policyFrames / elapsed.count() << " fps, latency ms"
+                  << " avg=" << frameLatencies.mean()
+                  << " p50=" << frameLatencies.percentile(50)
+                  << " p95=" << frameLatencies.percentile(95)
+                  << " p99=" << frameLatencies.percentile(99) << std::endl;
+        printPhotonLatencies("input-to-photon", inputToPhoton);
+        printPhotonLatencies("sample-to-photon (frames without new input)", sampleToPhoton);
+    }
+    
+    void printPhotonLatencies(const char* name, const PhotonLatencies& latencies) {
+        const SampleStats& milliseconds = latencies.milliseconds;
+        if (milliseconds.empty()) return;
+        std::cout << "  " << name << " ms"
+                  << " avg=" << milliseconds.mean()
+                  << " p50=" << milliseconds.percentile(50)
+                  << " p95=" << milliseconds.percentile(95)
+                  << " p99=" << milliseconds.percentile(99)
+                  << " (" << latencies.exact << " of " << milliseconds.total() << " timed exactly, the rest are upper bounds)" << std::endl;
+    }
+    
+    // With --present-sweep, move on to the next policy every presentSweepSeconds and close the window after the last one
+    void updatePresentSweep() {
+        if (options.presentSweepSeconds <= 0.0) return;
+        
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - policyStart;
+        if (elapsed.count() < options.presentSweepSeconds) return;
+        
+        PresentPolicy nextPolicy = presentPolicy;
+        switch (presentPolicy) {
+            case PresentPolicy::LowLatency: nextPolicy = PresentPolicy::MaxThroughput; break;
+            case PresentPolicy::MaxThroughput: nextPolicy = PresentPolicy::PowerSaving; break;
+            case PresentPolicy::PowerSaving: nextPolicy = PresentPolicy::LowLatency; break;
+        }
+        if (nextPolicy == options.presentPolicy) {
+            // Back where we started, every policy has been measured. mainLoop reports this last one on its way out
+            requestQuit();
+            return;
+        }
+        
+        recordFrameLatencies(pollCompletedFrame(graphicsTimeline));
+        printPresentPolicyReport();
+        presentPolicy = nextPolicy;
+        swapChainOutOfDate = true; // picked up by the next drawFrame, like a resize
+        needsRedraw = true;
+        startPresentPolicyMeasurement();
+        // Frames still in flight belong to the previous policy
+        pendingFrameStarts.clear();
+        presentWaiter.clear();
+    }
+    
+    void printFrameStatistics() {
+        if (framesRendered == 0) return;
+        std::cout << "Frames in flight: " << options.maxFramesInFlight
+                  << ". Frames rendered: " << framesRendered
+                  << ". Average CPU wait for a free frame: " << frameWaitTime.count() * 1000.0 / framesRendered << " ms" << std::endl;
+    }
+    
     void cleanup() {
-        vkDestroySemaphore(device, renderFinishedSemaphore, nullptr);
-        vkDestroySemaphore(device, imageAvailableSemaphore, nullptr);
-        vkDestroyCommandPool(device, commandPool, nullptr);
+        for (size_t i = 0; i < options.maxFramesInFlight; i++) {
+            vkDestroySemaphore(device, renderFinishedSemaphores[i], allocator(HostAllocationObject::Semaphore));
+            vkDestroySemaphore(device, imageAvailableSemaphores[i], allocator(HostAllocationObject::Semaphore));
+        }
+        vkDestroySemaphore(device, graphicsTimeline.semaphore, allocator(HostAllocationObject::Semaphore));
+        destroyPresentFences();
+        destroyRetiredSwapChains(UINT64_MAX); // the device is idle, everything can go
+        gpuProfiler.destroy();
+        hud.destroy();
+        vkDestroyCommandPool(device, commandPool, allocator(HostAllocationObject::CommandPool));
         for (auto framebuffer : swapChainFramebuffers) {
-            vkDestroyFramebuffer(device, framebuffer, nullptr);
+            vkDestroyFramebuffer(device, framebuffer, allocator(HostAllocationObject::Framebuffer));
         }
-        vkDestroyPipeline(device, graphicsPipeline, nullptr);
-        vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-        vkDestroyRenderPass(device, renderPass, nullptr);
+        vkDestroyPipeline(device, graphicsPipeline, allocator(HostAllocationObject::Pipeline));
+        vkDestroyPipelineLayout(device, pipelineLayout, allocator(HostAllocationObject::Pipeline));
+        vkDestroyPipeline(device, hudPipeline, allocator(HostAllocationObject::Pipeline));
+        vkDestroyPipelineLayout(device, hudPipelineLayout, allocator(HostAllocationObject::Pipeline));
+        vkDestroyRenderPass(device, renderPass, allocator(HostAllocationObject::RenderPass));
         for (auto imageView : swapChainImageViews) {
-            vkDestroyImageView(device, imageView, nullptr);
+            vkDestroyImageView(device, imageView, allocator(HostAllocationObject::ImageView));
+        }
+        if (options.headless) {
+            for (size_t i = 0; i < swapChainImages.size(); i++) {
+                vkDestroyImage(device, swapChainImages[i], allocator(HostAllocationObject::Image));
+                vkFreeMemory(device, offscreenImageMemory[i], allocator(HostAllocationObject::Memory));
+            }
+        } else {
+            vkDestroySwapchainKHR(device, swapChain, allocator(HostAllocationObject::Swapchain));
         }
-        vkDestroySwapchainKHR(device, swapChain, nullptr);
-        vkDestroyDevice(device, nullptr);
-        if (enableValidationLayers) {
-            DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
+        vkDestroyDevice(device, allocator(HostAllocationObject::Device));
+        if (validationEnabled()) {
+            DestroyDebugUtilsMessengerEXT(instance, debugMessenger, allocator(HostAllocationObject::DebugMessenger));
+        }
+        if (!options.headless) {
+            vkDestroySurfaceKHR(instance, surface, allocator(HostAllocationObject::Surface));
+        }
+        vkDestroyInstance(instance, allocator(HostAllocationObject::Instance));
+        validationLogger.stop(); // after the instance is gone, nothing can call debugCallback anymore
+        if (!options.headless) {
+            glfwDestroyWindow(window);
+            glfwTerminate();
         }
-        vkDestroySurfaceKHR(instance, surface, nullptr);
-        vkDestroyInstance(instance, nullptr);
-        glfwDestroyWindow(window);
-        glfwTerminate();
     }
     
     void initWindow() {
-        glfwInit(); // Initializes the GLFW library
+        TraceZone zone(__func__);
+        {
+            TraceZone glfwZone("glfwInit");
+            glfwInit(); // Initializes the GLFW library
+        }
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API); // This prevents GLFW from creating an OpenGL context, because we're going to use Vulkan instead
-        glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE); // Make the windw non-resizable because we don't want to deal with its implications for now
+        glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE); // Resizing is handled by recreating the swapchain in drawFrame
         
-        window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr); // Create a window of WIDHTxHEIGHT, with "Vulkan" as its title. First nullprt is for specifying a monitor but we go for default, second one is related only to OpenGL
+        {
+            TraceZone windowZone("glfwCreateWindow");
+            window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr); // Create a window of WIDHTxHEIGHT, with "Vulkan" as its title. First nullprt is for specifying a monitor but we go for default, second one is related only to OpenGL
+        }
+        
+        // GLFW callbacks are plain functions, so we stash a pointer to ourselves in the window to get back to the app
+        glfwSetWindowUserPointer(window, this);
+        glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        
+        // Anything the user does or anything that damages the window contents means the on-demand mode has to draw again
+        glfwSetKeyCallback(window, keyCallback);
+        glfwSetMouseButtonCallback(window, [](GLFWwindow* window, int, int, int) { markDirty(window); });
+        glfwSetCursorPosCallback(window, [](GLFWwindow* window, double, double) { markDirty(window); });
+        glfwSetScrollCallback(window, [](GLFWwindow* window, double, double) { markDirty(window); });
+        glfwSetWindowRefreshCallback(window, [](GLFWwindow* window) { markDirty(window); });
+        glfwSetWindowFocusCallback(window, [](GLFWwindow* window, int) { markDirty(window); });
+    }
+    
+    static void framebufferResizeCallback(GLFWwindow* window, int width, int height) {
+        auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+        InputEvent event = {InputEvent::FramebufferResized};
+        event.width = width;
+        event.height = height;
+        app->postInputEvent(event);
+    }
+    
+    static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+        auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+        InputEvent event = {InputEvent::Key};
+        event.key = key;
+        event.action = action;
+        app->postInputEvent(event);
+    }
+    
+    static void markDirty(GLFWwindow* window) {
+        auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+        app->postInputEvent({InputEvent::Changed});
     }
     
     void createInstance() {
-        if (enableValidationLayers && !checkValidationLayerSupport()) {
-            throw std::runtime_error("Validation layers required but not available on this system");
+        TraceZone zone(__func__);
+        if (validationEnabled() && !checkValidationLayerSupport()) {
+            throw std::runtime_error(std::string("Validation (") + validationModeName(options.validation) + ") requested but the validation layers are not available on this system");
+        }
+        bool performanceValidation = options.validation == ValidationMode::Performance;
+        if (performanceValidation && !instanceCapabilities.hasLayerExtension(VK_EXT_VALIDATION_FEATURES_EXTENSION_NAME)) {
+            throw std::runtime_error("Performance validation needs VK_EXT_validation_features, which this validation layer doesn't have");
+        }
+        if (validationEnabled()) {
+            startValidationLogger(); // before the instance exists, creating it can already produce messages
         }
         
         VkApplicationInfo appInfo = {}; // We provide some info to the graphics driver about our app. Not mandatory but can help the driver with app or engine-specific optimizations
@@ -818,18 +2146,31 @@ class HelloTriangleApplication {
         appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
         appInfo.pEngineName = "No Engine";
         appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-        appInfo.apiVersion = VK_API_VERSION_1_0;
+        // The newest version both we and the loader know. Devices with an older one still work, they just get their features through extensions
+        instanceApiVersion = negotiateApiVersion(instanceCapabilities.apiVersion);
+        appInfo.apiVersion = instanceApiVersion;
         
         VkInstanceCreateInfo createInfo = {}; // Mandatory struct indicating global (as in program-wide and as opposed to device-specific) extensions and validation layers (for debugging)
         createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
         createInfo.pApplicationInfo = &appInfo; // points to the VkApplicationInfo struct above
         
         VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo;
-        if (enableValidationLayers) {
+        VkValidationFeaturesEXT validationFeatures = {};
+        if (validationEnabled()) {
             createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
             createInfo.ppEnabledLayerNames = validationLayers.data();
             populateDebugMessengerCreateInfo(debugCreateInfo);
             createInfo.pNext = (VkDebugUtilsMessengerCreateInfoEXT*) &debugCreateInfo;
+            if (performanceValidation) {
+                // Read by the validation layer when it's created along with the instance, and applies to everything after that
+                validationFeatures.sType = VK_STRUCTURE_TYPE_VALIDATION_FEATURES_EXT;
+                validationFeatures.enabledValidationFeatureCount = static_cast<uint32_t>(performanceValidationEnables.size());
+                validationFeatures.pEnabledValidationFeatures = performanceValidationEnables.data();
+                validationFeatures.disabledValidationFeatureCount = static_cast<uint32_t>(performanceValidationDisables.size());
+                validationFeatures.pDisabledValidationFeatures = performanceValidationDisables.data();
+                validationFeatures.pNext = createInfo.pNext;
+                createInfo.pNext = &validationFeatures;
+            }
         } else {
             createInfo.enabledLayerCount = 0;
             createInfo.pNext = nullptr;
@@ -837,10 +2178,25 @@ class HelloTriangleApplication {
         
         /*
          We centralized getting all the required extensions because not only GLFW does require extensions.
-         The bool parameter to listRequiredExtensions means whether or not we're in debug mode, which is equivalent to have validation layers enabled.
+         The first bool parameter to listRequiredExtensions means whether or not we're validating, which needs the debug utils extension for the messages.
+         The second one whether we'll have a window, and so need the surface extensions GLFW asks for.
          We then pass the values to the VkInstanceCreateInfo struct.
          */
-        std::vector<const char*> extensions = listRequiredExtensions(enableValidationLayers);
+        std::vector<const char*> extensions = listRequiredExtensions(validationEnabled(), !options.headless);
+        if (performanceValidation) {
+            extensions.push_back(VK_EXT_VALIDATION_FEATURES_EXTENSION_NAME); // comes from the validation layer, which we enable above
+        }
+        // Only for its VkPhysicalDeviceIDProperties: device UUIDs are how --device and the device cache name a GPU
+        if (instanceCapabilities.hasExtension(VK_KHR_EXTERNAL_MEMORY_CAPABILITIES_EXTENSION_NAME)) {
+            extensions.push_back(VK_KHR_EXTERNAL_MEMORY_CAPABILITIES_EXTENSION_NAME);
+            deviceUUIDsAvailable = true;
+        }
+        // Only so the device can have VK_EXT_swapchain_maintenance1, for its present fences
+        const std::vector<const char*> surfaceMaintenanceExtensions = {VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME, VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME};
+        if (!options.headless && instanceCapabilities.hasExtensions(surfaceMaintenanceExtensions)) {
+            extensions.insert(extensions.end(), surfaceMaintenanceExtensions.begin(), surfaceMaintenanceExtensions.end());
+            surfaceMaintenanceAvailable = true;
+        }
         createInfo.enabledExtensionCount = (uint32_t) extensions.size();
         createInfo.ppEnabledExtensionNames = extensions.data();
         
@@ -852,34 +2208,57 @@ class HelloTriangleApplication {
          
          Nearly all Vulkan functions return a value of type VkResult that is either VK_SUCCESS or an error code
          */
-        if (vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS) {
+        TraceZone createZone("vkCreateInstance"); // loads the ICDs and layers, often the slowest part of startup
+        if (vkCreateInstance(&createInfo, allocator(HostAllocationObject::Instance), &instance) != VK_SUCCESS) {
             throw std::runtime_error("Failed to create instance");
         }
     }
     
+    // nullptr (the driver's own allocator) unless --host-alloc is on
+    const VkAllocationCallbacks* allocator(HostAllocationObject object) const {
+        return hostAllocations.callbacks(object);
+    }
+    
+    bool validationEnabled() const {
+        return options.validation != ValidationMode::Off;
+    }
+    
+    void startValidationLogger() {
+        VkDebugUtilsMessageSeverityFlagBitsEXT minimum = VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT;
+        switch (options.logSeverity) {
+            case LogSeverity::Verbose: minimum = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT; break; // Diagnostic messages
+            case LogSeverity::Info: minimum = VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT; break;       // Informational, like resource creation
+            case LogSeverity::Warning: minimum = VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT; break; // Warnings
+            case LogSeverity::Error: minimum = VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT; break;     // Errors
+        }
+        VkDebugUtilsMessageTypeFlagsEXT types = 0;
+        if (options.logGeneral) types |= VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT;         // Event not related to performance or violation of specs
+        if (options.logValidation) types |= VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT;   // Spec violated
+        if (options.logPerformance) types |= VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT; // Potential non-optimal use
+        validationLogger.setFilter(severitiesFrom(minimum), types);
+        validationLogger.setRepeatLimit(options.logRepeats);
+        validationLogger.start();
+    }
+    
     void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo) {
         createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
-        createInfo.messageSeverity =
-        VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | // Diagnostic messages
-        VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | // Warnings
-        VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;    // Errors
-        createInfo.messageType =
-        VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT |    // Event not related to performance or violation of specs
-        VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | // Spec violated
-        VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT; // Potential non-optimal use
+        // Same filter as the logger's, so the layers don't even call us for messages we'd throw away
+        createInfo.messageSeverity = validationLogger.severities();
+        createInfo.messageType = validationLogger.types();
         createInfo.pfnUserCallback = debugCallback; // Pointer to the actual callback function
-        createInfo.pUserData = nullptr; // Used if we'd like to push custom data to the  callback.
+        createInfo.pUserData = &validationLogger; // Handed back to the callback, which has no other way to reach us
     }
     
     void setupDebugMessenger() {
-        if (!enableValidationLayers) return;
+        TraceZone zone(__func__);
+        if (!validationEnabled()) return;
         
         VkDebugUtilsMessengerCreateInfoEXT createInfo;
         populateDebugMessengerCreateInfo(createInfo);
 
         
-        if (CreateDebugUtilsMessengerEXT(instance, &createInfo, nullptr, &debugMessenger) != VK_SUCCESS) {
+        if (CreateDebugUtilsMessengerEXT(instance, &createInfo, allocator(HostAllocationObject::DebugMessenger), &debugMessenger) != VK_SUCCESS) {
             throw std::runtime_error("Failed to setup debug messenger");
         }
     }
@@ -904,26 +2283,11 @@ class HelloTriangleApplication {
     }
     
     bool checkValidationLayerSupport() {
-        uint32_t layerCount;
-        vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
-        std::vector<VkLayerProperties> availableLayers(layerCount);
-        vkEnumerateInstanceLayerProperties(&layerCount, availableLayers.data());
-        
         for (const char* layerName : validationLayers) {
-            bool layerFound = false;
-            
-            for (const auto& layerProperties : availableLayers) {
-                if (strcmp(layerName, layerProperties.layerName) == 0) {
-                    layerFound = true;
-                    break;
-                }
-            }
-            
-            if (!layerFound) {
+            if (!instanceCapabilities.hasLayer(layerName)) {
                 return false;
             }
         }
-        
         return true;
     }
     
@@ -934,7 +2298,8 @@ class HelloTriangleApplication {
             const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
             void* pUserData){
         
-        std::cerr << "Validation Layer: " << pCallbackData->pMessage << std::endl;
+        // No I/O here: we're inside someone's Vulkan call. The logger filters, copies the message and returns
+        static_cast<ValidationLogger*>(pUserData)->log(messageSeverity, messageType, pCallbackData);
         
         return VK_FALSE; // does the call that triggered this need to be aborted?
     }
@@ -946,53 +2311,190 @@ class HelloTriangleApplication {
          buffer
          - Return the image to the swap chain for presentation
          
-         Only problem: asyncronous functions. Enter semaphores
+         Only problem: asyncronous functions. Enter semaphores (GPU-GPU sync) and the timeline (GPU-CPU sync)
          */
         
+        auto frameStart = std::chrono::steady_clock::now();
+        
+        // Refresh our view of the GPU's progress once per frame, so the waits below can skip the driver for frames already done
+        pollCompletedFrame(graphicsTimeline);
+        destroyRetiredSwapChains(graphicsTimeline.completed);
+        recordFrameLatencies(graphicsTimeline.completed);
+        
+        if (swapChainOutOfDate && !recreateSwapChain()) {
+            return; // minimized, nothing to draw to
+        }
+        
+        // Only becomes frameNumber once we know we'll submit, otherwise the timeline would wait for a value that is never signaled
+        uint64_t nextFrame = frameNumber + 1;
+        size_t currentFrame = nextFrame % options.maxFramesInFlight; // slot in the frames in flight ring
+        
+        // Don't get more than maxFramesInFlight ahead of the GPU: wait until the frame that last used this slot is done
+        auto waitStart = std::chrono::steady_clock::now();
+        if (nextFrame > options.maxFramesInFlight) {
+            waitForFrame(graphicsTimeline, nextFrame - options.maxFramesInFlight);
+        }
+        
         // Acquire
         uint32_t imageIndex; // index in swapChainImages of the swapchain image (VkImage) that has been acquired
-        vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+        if (options.headless) {
+            // Our own images: nobody else is using them, so just take the next one. The imageFrameNumbers wait below covers reuse
+            imageIndex = static_cast<uint32_t>(nextFrame % swapChainImages.size());
+        } else {
+            VkResult result = dispatch.vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+            if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+                // Can't render to this swapchain at all anymore. The semaphore was not signaled, so the slot is still clean
+                swapChainOutOfDate = true;
+                return;
+            } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+                // Suboptimal still gives us an image we can present, we'll recreate after this frame
+                throw std::runtime_error("Failed to acquire swap chain image");
+            }
+        }
+        frameNumber = nextFrame;
+        
+        // The swapchain may hand us images out of order, so an older frame might still be rendering to this one
+        waitForFrame(graphicsTimeline, imageFrameNumbers[imageIndex]);
+        collectGpuTimes(imageIndex); // that older frame is done, so reading its timestamps now can't stall
+        updateHud(imageIndex, frameStart); // and we can overwrite its overlay vertices
+        imageFrameNumbers[imageIndex] = frameNumber; // this image now belongs to this frame
+        frameWaitTime += std::chrono::steady_clock::now() - waitStart;
         
         //Execute
         VkSubmitInfo submitInfo = {};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
         
-        VkSemaphore waitSemaphores[] = {imageAvailableSemaphore}; // wait for these ...
+        VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]}; // wait for these ...
         VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT}; // ... at these stages
         submitInfo.waitSemaphoreCount = 1;
         submitInfo.pWaitSemaphores = waitSemaphores;
         submitInfo.pWaitDstStageMask = waitStages;
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = &commandBuffers[imageIndex]; // the command buffer associated with the image we acquired
-        VkSemaphore signalSemaphores[] = {renderFinishedSemaphore}; // which semaphores to signal after finishing execution
-        submitInfo.signalSemaphoreCount = 1;
+        VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame], graphicsTimeline.semaphore}; // which semaphores to signal after finishing execution
+        submitInfo.signalSemaphoreCount = 2;
         submitInfo.pSignalSemaphores = signalSemaphores;
         
-        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        // Values for each signal semaphore. Binary semaphores ignore theirs, the timeline moves to this frame's number
+        uint64_t signalValues[] = {0, frameNumber};
+        VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+        timelineInfo.signalSemaphoreValueCount = 2;
+        timelineInfo.pSignalSemaphoreValues = signalValues;
+        submitInfo.pNext = &timelineInfo;
+        
+        if (options.headless) {
+            // Nothing was acquired and nothing will be presented, so the binary semaphores stay out of it. The timeline is all we need
+            submitInfo.waitSemaphoreCount = 0;
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores = &signalSemaphores[1];
+            timelineInfo.signalSemaphoreValueCount = 1;
+            timelineInfo.pSignalSemaphoreValues = &signalValues[1];
+        }
+        
+        auto submitStart = std::chrono::steady_clock::now();
+        if (dispatch.vkQueueSubmit(graphicsTimeline.queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
             throw std::runtime_error("Failed to submit draw command buffer");
         }
+        std::chrono::duration<double, std::milli> submitTime = std::chrono::steady_clock::now() - submitStart;
+        graphicsTimeline.submitted = frameNumber;
+        pendingFrameStarts.emplace_back(frameNumber, frameStart);
+        gpuProfiler.submitted(imageIndex, frameNumber);
+        
+        double presentMs = -1.0; // headless: nothing presented
+        if (!options.headless) {
+            auto presentStart = std::chrono::steady_clock::now();
+            presentFrame(currentFrame, imageIndex); // practically all of it is vkQueuePresentKHR
+            presentMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - presentStart).count();
+        }
         
+        framesRendered++;
+        policyFrames++;
+        auto frameEnd = std::chrono::steady_clock::now();
+        lastFrameCpuMilliseconds = std::chrono::duration<double, std::milli>(frameEnd - frameStart).count();
+        benchmark.recordFrame(frameStart, frameEnd, submitTime.count(), presentMs);
+        sampleMemoryBudget(frameNumber);
+    }
+    
+    // After the frame's CPU work, so the query isn't counted in its timings
+    void sampleMemoryBudget(uint64_t frame) {
+        if (!memoryBudget.enabled()) return;
+        memoryBudget.sample(frame);
+        if (benchmark.enabled()) {
+            for (size_t i = 0; i < memoryBudget.heapCount(); i++) {
+                std::string heap = "heap" + std::to_string(i);
+                benchmark.recordGpuCounter(frame, heap + ".usage_mib", memoryBudget.usage(i) / (1024.0 * 1024.0));
+                benchmark.recordGpuCounter(frame, heap + ".budget_mib", memoryBudget.budget(i) / (1024.0 * 1024.0));
+            }
+        }
+    }
+    
+    void presentFrame(size_t currentFrame, uint32_t imageIndex) {
         //return to the swapchain
         VkPresentInfoKHR presentInfo = {};
         presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
         
         presentInfo.waitSemaphoreCount = 1;
-        presentInfo.pWaitSemaphores = signalSemaphores;
+        presentInfo.pWaitSemaphores = &renderFinishedSemaphores[currentFrame]; // only the binary one, presentation can't wait on timelines
         
         VkSwapchainKHR swapChains[] = {swapChain};
         presentInfo.swapchainCount = 1;
         presentInfo.pSwapchains = swapChains;
         presentInfo.pImageIndices = &imageIndex;
         
+        // Tag the present with the frame number so we can ask when it reached the display
+        VkPresentIdKHR presentId = {};
+        presentId.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+        presentId.swapchainCount = 1;
+        presentId.pPresentIds = &frameNumber;
+        if (presentWaitEnabled) {
+            presentInfo.pNext = &presentId;
+        }
+        
+        // The first present on a swapchain that replaced others gets a fence, destroyRetiredSwapChains waits for it
+        VkFence presentFence = VK_NULL_HANDLE;
+        VkSwapchainPresentFenceInfoEXT presentFenceInfo = {};
+        if (presentFencesEnabled && !retiredSwapChains.empty() && retiredSwapChains.back().lastPresent >= lastFencedPresent) {
+            presentFence = takePresentFence();
+            presentFenceInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_FENCE_INFO_EXT;
+            presentFenceInfo.pNext = presentInfo.pNext;
+            presentFenceInfo.swapchainCount = 1;
+            presentFenceInfo.pFences = &presentFence;
+            presentInfo.pNext = &presentFenceInfo;
+        }
+        
         // present to screen!
-        vkQueuePresentKHR(presentQueue, &presentInfo);
+        VkResult result = dispatch.vkQueuePresentKHR(presentQueue, &presentInfo);
+        if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) {
+            presentsQueued++;
+            if (presentFence != VK_NULL_HANDLE) {
+                presentFences.push_back({presentFence, presentsQueued});
+                lastFencedPresent = presentsQueued;
+            }
+            if (presentWaitEnabled) {
+                presentWaiter.watch(swapChain, frameNumber, lastInputTime, lastInputFromEvent); // suboptimal presents are still shown, so they're measured too
+            }
+        }
+        // The frame is out, so as far as on-demand rendering goes we're up to date
+        needsRedraw = false;
+        lastRedrawTime = std::chrono::steady_clock::now();
+        
+        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
+            swapChainOutOfDate = true; // recreated at the start of the next frame
+            needsRedraw = true; // and the new swapchain has nothing on it yet
+            framebufferResized = false;
+        } else if (result != VK_SUCCESS) {
+            throw std::runtime_error("Failed to present swap chain image");
+        }
+        if (presentFence != VK_NULL_HANDLE && result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+            rejectedPresentFences.push_back(presentFence); // the next present tries again with a fresh one
+        }
     }
 };
 
-int main() {
-    HelloTriangleApplication app;
-    
+int main(int argc, char** argv) {
     try {
+        HelloTriangleApplication app(parseOptions(argc, argv));
         app.run();
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
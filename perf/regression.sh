@@ -0,0 +1,95 @@
+#!/bin/sh
+#
+#  regression.sh
+#  VulkanTesting
+#
+#  Performance regression check on lavapipe, Mesa's software Vulkan driver, so it runs on any Linux box with or without a GPU.
+#
+#  Usage: perf/regression.sh path/to/VulkanTesting [--update]
+#
+#  Renders each scene below headless, benchmarks it and compares startup time, frame time and draw call throughput against
+#  perf/baselines/<scene>.json. Exits non-zero if any scene regressed by more than PERF_TOLERANCE percent (default: the app's own
+#  --tolerance default, 10). --update records the baselines instead. Do that on the machine the check runs on: numbers from another
+#  machine mean nothing, which is also why none are committed. Without them the check fails before running anything.
+#
+#  The repo has no build system, so this script stands in for what would otherwise be a perf test target: build VulkanTesting however
+#  you build it, then point this at the binary.
+#
+set -eu
+
+if [ $# -lt 1 ]; then
+    echo "Usage: $0 path/to/VulkanTesting [--update]" >&2
+    exit 2
+fi
+binary=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+update=0
+if [ "${2:-}" = "--update" ]; then
+    update=1
+fi
+# Empty leaves it to the app, so there's only one default
+tolerance=${PERF_TOLERANCE:-}
+root=$(cd "$(dirname "$0")/.." && pwd)
+baselines=$root/perf/baselines
+reports=${PERF_REPORTS:-$root/perf/reports}
+
+# Point the loader at lavapipe only, so a real GPU on the box can't get picked instead
+icd=${LAVAPIPE_ICD:-}
+if [ -z "$icd" ]; then
+    for candidate in /usr/share/vulkan/icd.d/lvp_icd*.json /usr/local/share/vulkan/icd.d/lvp_icd*.json /etc/vulkan/icd.d/lvp_icd*.json; do
+        if [ -f "$candidate" ]; then
+            icd=$candidate
+            break
+        fi
+    done
+fi
+if [ -z "$icd" ]; then
+    echo "lavapipe not found. Install Mesa's Vulkan drivers (mesa-vulkan-drivers on Debian/Ubuntu) or set LAVAPIPE_ICD" >&2
+    exit 2
+fi
+export VK_DRIVER_FILES="$icd"
+export VK_ICD_FILENAMES="$icd" # what older loaders call it
+# llvmpipe otherwise uses a thread per core, which makes the numbers depend on the machine's size and how busy it is
+export LP_NUM_THREADS=${LP_NUM_THREADS:-2}
+
+# Nothing to compare against is a setup problem, not a regression: say so once instead of running every scene first
+if [ $update -eq 0 ] && ! ls "$baselines"/*.json >/dev/null 2>&1; then
+    echo "No baselines in $baselines. Record them on this machine first with: $0 $1 --update" >&2
+    exit 2
+fi
+
+mkdir -p "$baselines" "$reports"
+# The app loads shaders/*.spv relative to the working directory, and shaders/ sits at the root of the repo
+cd "$root"
+for shader in vert frag hud_vert hud_frag; do
+    if [ ! -f "shaders/$shader.spv" ]; then
+        echo "$root/shaders/$shader.spv is missing, build the shaders first with shaders/compile.sh" >&2
+        exit 2
+    fi
+done
+
+# name and arguments of each scene. Frame counts are fixed so every run does the same work
+scenes="triangle --draws=1
+draws_1000 --draws=1000
+hud --draws=1 --hud"
+
+failed=0
+echo "$scenes" | {
+    while read -r name arguments; do
+        echo "== $name"
+        baseline=$baselines/$name.json
+        if [ $update -eq 1 ]; then
+            check="--write-baseline=$baseline"
+        elif [ -f "$baseline" ]; then
+            check="--baseline=$baseline${tolerance:+ --tolerance=$tolerance}"
+        else
+            echo "No baseline for $name, record one with: $0 $1 --update" >&2
+            failed=1
+            continue
+        fi
+        # shellcheck disable=SC2086 # arguments and check are lists of options
+        if ! "$binary" --headless --validation=off --device-cache=off --warmup=60 --benchmark=300 --report="$reports/$name.json" $arguments $check; then
+            failed=1
+        fi
+    done
+    exit $failed
+}
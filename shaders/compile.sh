@@ -0,0 +1,11 @@
+#!/bin/sh
+# Builds the SPIR-V the application loads. glslc comes with the Vulkan SDK (or shaderc).
+# Run from anywhere; the .spv files are written next to their sources
+set -e
+cd "$(dirname "$0")"
+GLSLC=${GLSLC:-glslc}
+
+$GLSLC shader.vert -o vert.spv
+$GLSLC shader.frag -o frag.spv
+$GLSLC hud.vert -o hud_vert.spv
+$GLSLC hud.frag -o hud_frag.spv
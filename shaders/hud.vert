@@ -0,0 +1,12 @@
+#version 450
+
+// HUD overlay: positions are already in clip space and colors come per vertex, the CPU does all the work
+layout(location=0) in vec2 inPosition;
+layout(location=1) in vec4 inColor;
+
+layout(location=0) out vec4 fragColor;
+
+void main() {
+    gl_Position = vec4(inPosition, 0.0, 1.0);
+    fragColor = inColor;
+}